@@ -95,6 +95,7 @@ class AMQPMessage {
 
 	char * data;
 	uint32_t len;
+	uint32_t capacity;
 	std::string exchange;
 	std::string routing_key;
 	uint32_t delivery_tag;
@@ -108,6 +109,8 @@ class AMQPMessage {
 		~AMQPMessage();
 
 		void setMessage(const char * data,uint32_t length);
+		char * reserveMessage(uint32_t length);
+		void reset();
 		char * getMessage(uint32_t* length);
 
 		void addHeader(std::string name, amqp_bytes_t * value);
@@ -115,6 +118,7 @@ class AMQPMessage {
 		void addHeader(std::string name, uint8_t * value);
 		void addHeader(amqp_bytes_t * name, amqp_bytes_t * value);
 		std::string getHeader(std::string name);
+		const std::string * findHeader(const std::string & name);
 
 		void setConsumerTag( amqp_bytes_t consumer_tag);
 		void setConsumerTag( std::string consumer_tag);
@@ -174,6 +178,9 @@ class AMQPQueue : public AMQPBase  {
 		amqp_bytes_t consumer_tag;
 		uint32_t delivery_tag;
 		uint32_t count;
+#if __cplusplus > 199711L // C++11 or greater
+		std::function<char*(AMQPMessage*, size_t)> bodyAllocator;
+#endif
 	public:
 		AMQPQueue(amqp_connection_state_t * cnn, int channelNum);
 		AMQPQueue(amqp_connection_state_t * cnn, int channelNum, std::string name);
@@ -198,6 +205,16 @@ class AMQPQueue : public AMQPBase  {
 		void Consume();
 		void Consume(short param);
 
+		// basic.consume without the blocking loop, deliveries are then read with NextDelivery
+		void StartConsume(short param);
+		bool NextDelivery(struct timeval * timeout);
+		int getSocket();
+#if __cplusplus > 199711L // C++11 or greater
+		// called with the headers of each delivery once its size is known, returns where to assemble the body
+		// or NULL to keep it in the message
+		void setBodyAllocator(std::function<char*(AMQPMessage*, size_t)> allocator);
+#endif
+
 		void Cancel(amqp_bytes_t consumer_tag);
 		void Cancel(std::string consumer_tag);
 
@@ -231,6 +248,7 @@ class AMQPQueue : public AMQPBase  {
 		void sendUnBindCommand(const char * exchange, const char * key);
 		void sendGetCommand();
 		void sendConsumeCommand();
+		bool sendConsumeRequest();
 		void sendCancelCommand();
 		void sendAckCommand();
 		void setHeaders(amqp_basic_properties_t * p);
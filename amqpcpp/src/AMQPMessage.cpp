@@ -14,6 +14,8 @@ AMQPMessage::AMQPMessage( AMQPQueue * queue ) {
 	this->queue=queue;
 	 message_count=-1;
 	 data=NULL;
+	 len=0;
+	 capacity=0;
 }
 
 AMQPMessage::~AMQPMessage() {
@@ -36,6 +38,40 @@ void AMQPMessage::setMessage(const char * data,uint32_t length) {
 	memcpy(this->data,data,length);
 	this->data[length] = '\0';
 	this->len = length;
+	this->capacity = length + 1;
+}
+
+/*
+ * Makes room for a body of length bytes, to be written straight into the returned buffer.
+ * The buffer is kept between messages and only grows.
+ */
+char * AMQPMessage::reserveMessage(uint32_t length) {
+	if (!this->data || this->capacity < length + 1) {
+		free(this->data);
+		this->data = (char*)malloc(length + 1);
+		if (!this->data) {
+			this->capacity = 0;
+			throw AMQPException("reserveMessage: malloc failed");
+		}
+		this->capacity = length + 1;
+	}
+	this->data[length] = '\0';
+	this->len = length;
+	return this->data;
+}
+
+/*
+ * Empties the message for reuse by the next delivery, buffers and header entries keep their memory.
+ */
+void AMQPMessage::reset() {
+	if (this->data)
+		this->data[0] = '\0';
+	this->len = 0;
+	this->message_count = -1;
+	this->exchange.clear();
+	this->routing_key.clear();
+	for (map<string,string>::iterator i = headers.begin(); i != headers.end(); ++i)
+		i->second.clear();
 }
 
 char * AMQPMessage::getMessage(uint32_t* length) {
@@ -103,9 +139,7 @@ string AMQPMessage::getRoutingKey() {
 }
 
 void AMQPMessage::addHeader(string name, amqp_bytes_t * value) {
-	string svalue;
-	svalue.assign(( const char *) value->bytes, value->len);
-	headers[name] = svalue;
+	headers[name].assign(( const char *) value->bytes, value->len);
 	//headers.insert( pair<string,string>(name,svalue));
 }
 
@@ -142,6 +176,16 @@ string AMQPMessage::getHeader(string name) {
 		return headers[name];
 }
 
+/*
+ * Like getHeader without copying the value, NULL if the message has no such header.
+ */
+const string * AMQPMessage::findHeader(const string & name) {
+	map<string,string>::const_iterator i = headers.find(name);
+	if (i == headers.end() || i->second.empty())
+		return NULL;
+	return &i->second;
+}
+
 AMQPQueue * AMQPMessage::getQueue() {
 	return queue;
 }
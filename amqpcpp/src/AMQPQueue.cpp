@@ -392,8 +392,98 @@ void AMQPQueue::setConsumerTag(string consumer_tag) {
 	this->consumer_tag = amqp_cstring_bytes(consumer_tag.c_str());
 }
 
-void AMQPQueue::sendConsumeCommand() {
-//	amqp_basic_consume_ok_t *consume_ok;
+void AMQPQueue::StartConsume(short parms) {
+	this->parms=parms;
+	sendConsumeRequest();
+}
+
+/*
+ * Reads the next delivery of a consumer started with StartConsume into getMessage().
+ * Frames already buffered are used first, then the socket is waited on for at most
+ * timeout, NULL waits forever and a zero timeval only takes what has already arrived.
+ * The message is reused between deliveries and the body is assembled in place, in the
+ * message or wherever the body allocator says, so a steady stream allocates nothing.
+ * Returns false if nothing was delivered in time.
+ */
+bool AMQPQueue::NextDelivery(struct timeval * timeout) {
+	amqp_frame_t frame;
+	while (1) {
+		amqp_maybe_release_buffers(*cnn);
+		int result = amqp_simple_wait_frame_noblock(*cnn, &frame, timeout);
+		if (result == AMQP_STATUS_TIMEOUT)
+			return false;
+		if (result != AMQP_STATUS_OK)
+			throw AMQPException("read frame error");
+		if (frame.frame_type != AMQP_FRAME_METHOD)
+			continue;
+		if (frame.payload.method.id == AMQP_CHANNEL_CLOSE_METHOD || frame.payload.method.id == AMQP_CONNECTION_CLOSE_METHOD) {
+			opened=0;
+			throw AMQPException("the server closed the consumer's channel");
+		}
+		// anything else, e.g. a returned message, is not for the consumer
+		if (frame.payload.method.id == AMQP_BASIC_DELIVER_METHOD)
+			break;
+	}
+
+	if (pmessage)
+		pmessage->reset();
+	else
+		pmessage = new AMQPMessage(this);
+
+	amqp_basic_deliver_t * delivery = (amqp_basic_deliver_t*) frame.payload.method.decoded;
+	delivery_tag = delivery->delivery_tag;
+	pmessage->setConsumerTag(delivery->consumer_tag);
+	pmessage->setDeliveryTag(delivery->delivery_tag);
+	pmessage->setExchange(delivery->exchange);
+	pmessage->setRoutingKey(delivery->routing_key);
+
+	if (amqp_simple_wait_frame(*cnn, &frame) != AMQP_STATUS_OK)
+		throw AMQPException("The returned read frame is invalid");
+	if (frame.frame_type != AMQP_FRAME_HEADER)
+		throw AMQPException("The returned frame type is invalid");
+	this->setHeaders((amqp_basic_properties_t *) frame.payload.properties.decoded);
+
+	size_t body_target = frame.payload.properties.body_size;
+	char * body = NULL;
+#if __cplusplus > 199711L // C++11 or greater
+	if (bodyAllocator)
+		body = bodyAllocator(pmessage, body_target);
+#endif
+	if (body == NULL)
+		body = pmessage->reserveMessage(body_target);
+
+	size_t body_received = 0;
+	while (body_received < body_target) {
+		if (amqp_simple_wait_frame(*cnn, &frame) != AMQP_STATUS_OK)
+			throw AMQPException("The returned read frame is invalid");
+		if (frame.frame_type != AMQP_FRAME_BODY)
+			throw AMQPException("The returned frame has no body");
+		size_t len = frame.payload.body_fragment.len;
+		if (len > body_target - body_received)
+			len = body_target - body_received;
+		memcpy(body + body_received, frame.payload.body_fragment.bytes, len);
+		body_received += len;
+	}
+	return true;
+}
+
+#if __cplusplus > 199711L // C++11 or greater
+void AMQPQueue::setBodyAllocator(std::function<char*(AMQPMessage*, size_t)> allocator) {
+	bodyAllocator = allocator;
+}
+#endif
+
+/*
+ * The broker connection's socket, readable when NextDelivery has something to read.
+ */
+int AMQPQueue::getSocket() {
+	return amqp_get_sockfd(*cnn);
+}
+
+/*
+ * Sends basic.consume and waits for the reply. Returns false if the server answered with cancel-ok.
+ */
+bool AMQPQueue::sendConsumeRequest() {
 	amqp_bytes_t queueByte = amqp_cstring_bytes(name.c_str());
 
 	char error_message[256];
@@ -437,12 +527,19 @@ void AMQPQueue::sendConsumeCommand() {
 
 		throw AMQPException(error_message);
 	} else if (res.reply.id == AMQP_BASIC_CANCEL_OK_METHOD) {
-		return;//cancel ok
+		return false;//cancel ok
 	}
 //		else if (res.reply.id == AMQP_BASIC_CONSUME_OK_METHOD) {
 //		consume_ok = (amqp_basic_consume_ok_t*) res.reply.decoded;
 //		//printf("****** consume Ok c_tag=%s", consume_ok->consumer_tag.bytes );
 //	}
+	return true;
+}
+
+void AMQPQueue::sendConsumeCommand() {
+	if (!sendConsumeRequest())
+		return;
+
 #if __cplusplus > 199711L // C++11 or greater
         unique_ptr<AMQPMessage> message ( new AMQPMessage(this) );
 #else
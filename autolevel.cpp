@@ -0,0 +1,104 @@
+#include "autolevel.h"
+
+AutoLevel::AutoLevel(){
+    this->reset();
+}
+
+/**
+ * @brief AutoLevel::reset forget all history, the displayed range is kept
+ */
+void AutoLevel::reset(){
+    memset(this->buckets, 0, sizeof(this->buckets));
+    this->weight = 1.0;
+    this->total = 0.0;
+}
+
+/**
+ * @brief AutoLevel::addRow add one frame of values to the histogram
+ * @param values power values in dB, double, float or int16 centi-dB
+ * @param n number of values
+ */
+template<typename T>
+void AutoLevel::addRow(const T* values, int n){
+    const float w = float(this->weight);
+    for(int i = 0; i < n; i++){
+        // clamp before converting, int() of NaN, inf or anything out of range is undefined. NaN goes to the bottom
+        double x = (SampleTraits<T>::toDb(values[i]) - AUTOLEVEL_MIN_DB)/AUTOLEVEL_BUCKET_DB;
+        x = !(x > 0.0) ? 0.0 : (x < double(AUTOLEVEL_BUCKETS - 1) ? x : double(AUTOLEVEL_BUCKETS - 1));
+        this->buckets[int(x)] += w;
+    }
+    this->total += double(w)*n;
+
+    // older frames lose weight relative to the next one
+    this->weight /= this->decay;
+    if(this->weight > 1.0e6){
+        this->renormalize();
+    }
+}
+
+/**
+ * @brief AutoLevel::renormalize scale every bucket back down so the weights stay representable
+ */
+void AutoLevel::renormalize(){
+    const float s = float(1.0/this->weight);
+    for(int i = 0; i < AUTOLEVEL_BUCKETS; i++){
+        this->buckets[i] *= s;
+    }
+    this->total /= this->weight;
+    this->weight = 1.0;
+}
+
+/**
+ * @brief AutoLevel::percentile find the power below which fraction p of the recent samples fall
+ * @param p fraction between 0 and 1
+ * @return power in dB
+ */
+double AutoLevel::percentile(double p){
+    double target = p*this->total;
+    double sum = 0.0;
+    for(int i = 0; i < AUTOLEVEL_BUCKETS; i++){
+        sum += this->buckets[i];
+        if(sum >= target){
+            return AUTOLEVEL_MIN_DB + (i + 0.5)*AUTOLEVEL_BUCKET_DB;
+        }
+    }
+    return AUTOLEVEL_MAX_DB;
+}
+
+/**
+ * @brief AutoLevel::update move the displayed range toward the current estimates
+ * @return true if the range changed
+ * Each end only moves once its estimate is more than hysteresis dB away,
+ * and then only part of the way, so the colors don't flicker between frames.
+ */
+bool AutoLevel::update(){
+    if(this->total <= 0.0){
+        return false;
+    }
+    double floor = this->percentile(this->noiseFloorPercentile);
+    double peak  = this->percentile(this->peakPercentile);
+    if(peak - floor < this->minSpan){
+        double mid = (peak + floor)/2.0;
+        floor = mid - this->minSpan/2.0;
+        peak  = mid + this->minSpan/2.0;
+    }
+
+    double newMin = this->min;
+    double newMax = this->max;
+    if(floor - this->min > this->hysteresis || this->min - floor > this->hysteresis){
+        newMin += (floor - this->min)*this->rate;
+    }
+    if(peak - this->max > this->hysteresis || this->max - peak > this->hysteresis){
+        newMax += (peak - this->max)*this->rate;
+    }
+    if(newMin == this->min && newMax == this->max){
+        return false;
+    }
+    this->min = newMin;
+    this->max = newMax;
+    return true;
+}
+
+template void AutoLevel::addRow<double>(const double* values, int n);
+template void AutoLevel::addRow<float>(const float* values, int n);
+template void AutoLevel::addRow<int16_t>(const int16_t* values, int n);
@@ -0,0 +1,47 @@
+#ifndef AUTOLEVEL_H
+#define AUTOLEVEL_H
+
+#include <cstdlib>
+#include <cstring>
+#include "sampletype.h"
+
+#define AUTOLEVEL_MIN_DB        -160.0  // lowest power tracked by the histogram
+#define AUTOLEVEL_MAX_DB        40.0    // highest power tracked by the histogram
+#define AUTOLEVEL_BUCKET_DB     0.5     // histogram bucket width
+#define AUTOLEVEL_BUCKETS       400     // (AUTOLEVEL_MAX_DB - AUTOLEVEL_MIN_DB)/AUTOLEVEL_BUCKET_DB
+
+/**
+ * @brief The AutoLevel class tracks the noise floor and peak level of recent FFT frames
+ * Values are binned into a fixed histogram whose old counts decay exponentially,
+ * so percentiles come from one walk over the buckets instead of a sort.
+ * The decay is applied lazily by growing the weight of new samples and
+ * renormalizing only when that weight gets large.
+ */
+class AutoLevel
+{
+public:
+    AutoLevel();
+    void reset();
+    template<typename T> void addRow(const T* values, int n);
+    double percentile(double p);
+    bool update();
+    void setRange(double min, double max) { this->min = min; this->max = max; }
+    double getMin() { return min; }
+    double getMax() { return max; }
+    double noiseFloorPercentile = 0.20;  // fraction of samples considered noise
+    double peakPercentile       = 0.995; // fraction of samples below the displayed peak
+    double decay                = 0.98;  // weight kept by older frames, per frame
+    double hysteresis           = 3.0;   // dB the estimate must move before the range follows
+    double rate                 = 0.2;   // fraction of the error corrected per update
+    double minSpan              = 20.0;  // dB, keeps a quiet band from being stretched into noise
+
+private:
+    void renormalize();
+    float buckets[AUTOLEVEL_BUCKETS];
+    double weight = 1.0;    // weight of the next sample, grows by 1/decay each frame
+    double total = 0.0;     // sum of all bucket weights
+    double min = -50.0;     // currently displayed range
+    double max = 50.0;
+};
+
+#endif // AUTOLEVEL_H
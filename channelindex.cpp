@@ -0,0 +1,88 @@
+#include "channelindex.h"
+
+/**
+ * @brief markerLessThan order markers by frequency, scan list entries first at equal frequencies
+ */
+static bool markerLessThan(const ChannelMarker& m1, const ChannelMarker& m2){
+    if(m1.frequency != m2.frequency){
+        return m1.frequency < m2.frequency;
+    }
+    return m1.scanned && !m2.scanned;
+}
+
+/**
+ * @brief ChannelIndex::build replace the index with the given channels
+ * @param channels known channels, typically the selected county's
+ * @param scanList channels in the active scan list, marked as scanned
+ * O(n log n), only called when a channel list changes. Channels without a
+ * frequency (talkgroups) are skipped, duplicates of a scanned channel are dropped.
+ */
+void ChannelIndex::build(const QVector<Channel>& channels, const QVector<Channel>& scanList){
+    this->markers.clear();
+    this->markers.reserve(channels.size() + scanList.size());
+    for(int list = 0; list < 2; list++){
+        const QVector<Channel>& source = list == 0 ? scanList : channels;
+        for(const Channel& ch : source){
+            if(ch.frequency <= 0.0){
+                continue;
+            }
+            ChannelMarker marker;
+            marker.frequency = ch.frequency;
+            marker.label = ch.alpha_tag.isEmpty() ? ch.description : ch.alpha_tag;
+            marker.scanned = list == 0;
+            this->markers.append(marker);
+        }
+    }
+    std::sort(this->markers.begin(), this->markers.end(), markerLessThan);
+
+    // the scan list is usually taken from the county's channels, keep one of each
+    int kept = 0;
+    for(int i = 0; i < this->markers.size(); i++){
+        if(kept > 0 && this->markers[kept - 1].frequency == this->markers[i].frequency
+                    && this->markers[kept - 1].label == this->markers[i].label){
+            continue;
+        }
+        this->markers[kept++] = this->markers[i];
+    }
+    this->markers.resize(kept);
+
+    this->frequencies.resize(kept);
+    for(int i = 0; i < kept; i++){
+        this->frequencies[i] = this->markers[i].frequency;
+    }
+    this->version++;
+}
+
+/**
+ * @brief ChannelIndex::clear remove all channels
+ */
+void ChannelIndex::clear(){
+    this->markers.clear();
+    this->frequencies.clear();
+    this->version++;
+}
+
+/**
+ * @brief ChannelIndex::lowerBound find the first channel at or above a frequency
+ * @param freq Hz
+ * @return index of the channel, size() if there is none
+ */
+int ChannelIndex::lowerBound(double freq) const{
+    const double* begin = this->frequencies.constData();
+    return int(std::lower_bound(begin, begin + this->frequencies.size(), freq) - begin);
+}
+
+/**
+ * @brief ChannelIndex::range find the channels inside a frequency window
+ * @param low lowest frequency in Hz, inclusive
+ * @param high highest frequency in Hz, inclusive
+ * @param first set to the index of the first channel in the window
+ * @param last set to one past the index of the last channel in the window
+ * O(log n), the channels are at(first) .. at(last - 1)
+ */
+void ChannelIndex::range(double low, double high, int* first, int* last) const{
+    const double* begin = this->frequencies.constData();
+    const double* end = begin + this->frequencies.size();
+    *first = int(std::lower_bound(begin, end, low) - begin);
+    *last = int(std::upper_bound(begin + *first, end, high) - begin);
+}
@@ -0,0 +1,40 @@
+#ifndef CHANNELINDEX_H
+#define CHANNELINDEX_H
+
+#include <QVector>
+#include <QString>
+#include <algorithm>
+#include "radio.h"
+
+/**
+ * @brief The ChannelMarker struct is one known channel to mark on the waterfall
+ */
+struct ChannelMarker {
+    double frequency = 0.0; // Hz
+    QString label;          // alpha tag, or the description if there is none
+    bool scanned = false;   // part of the active scan list
+};
+
+/**
+ * @brief The ChannelIndex class keeps known channels sorted by frequency
+ * Finding the channels inside a frequency window is a binary search, so the
+ * cost depends on how many channels are visible rather than how many are known.
+ */
+class ChannelIndex
+{
+public:
+    void build(const QVector<Channel>& channels, const QVector<Channel>& scanList);
+    void clear();
+    int lowerBound(double freq) const;
+    void range(double low, double high, int* first, int* last) const;
+    const ChannelMarker& at(int i) const { return markers[i]; }
+    int size() const { return markers.size(); }
+    quint64 getVersion() const { return version; }
+
+private:
+    QVector<ChannelMarker> markers; // sorted by frequency
+    QVector<double> frequencies;    // the markers' frequencies, packed for the binary search
+    quint64 version = 0;            // bumped on every change so cached positions can be dropped
+};
+
+#endif // CHANNELINDEX_H
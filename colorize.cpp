@@ -0,0 +1,347 @@
+#include "colorize.h"
+
+/**
+ * @brief colorIndex quantize a single value to an index into the colormap
+ * @param value power in dB
+ * @param scale colormap steps per dB
+ * @param offset index of 0 dB, plus 0.5 for rounding
+ * @return index between 0 and COLORMAP_SIZE - 1
+ */
+static inline int colorIndex(double value, float scale, float offset){
+    float x = float(value)*scale + offset;
+    if(!(x > 0.0f)){
+        return 0; // also catches NaN
+    }
+    return x < float(COLORMAP_SIZE - 1) ? int(x) : COLORMAP_SIZE - 1;
+}
+
+/**
+ * @brief colorizeRowScalar reference colorizer, one value at a time
+ * @param values fft values in dB
+ * @param n number of values
+ * @param min power mapped to the first colormap entry
+ * @param max power mapped to the last colormap entry
+ * @param lut colormap with COLORMAP_SIZE entries
+ * @param out n pixels
+ */
+void colorizeRowScalar(const double* values, int n, double min, double max, const uint32_t* lut, uint32_t* out){
+    double span = max > min ? max - min : 1.0;
+    float scale = float((COLORMAP_SIZE - 1)/span);
+    float offset = float(0.5 - min*(COLORMAP_SIZE - 1)/span);
+
+    for(int i = 0; i < n; i++){
+        out[i] = lut[colorIndex(values[i], scale, offset)];
+    }
+}
+
+/**
+ * @brief colorizeRow map a whole row of dB values to packed pixels
+ * @param values fft values in dB
+ * @param n number of values
+ * @param min power mapped to the first colormap entry
+ * @param max power mapped to the last colormap entry
+ * @param lut colormap with COLORMAP_SIZE entries
+ * @param out n pixels
+ * The index computation (convert, scale, clamp) is done in vector registers,
+ * the LUT lookup is a hardware gather on AVX2 and a scalar load otherwise.
+ */
+void colorizeRow(const double* values, int n, double min, double max, const uint32_t* lut, uint32_t* out){
+    double span = max > min ? max - min : 1.0;
+    float scale = float((COLORMAP_SIZE - 1)/span);
+    float offset = float(0.5 - min*(COLORMAP_SIZE - 1)/span);
+    int i = 0;
+
+#if defined(COLORIZE_AVX2)
+    const __m256 vscale  = _mm256_set1_ps(scale);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    const __m256 vlo     = _mm256_setzero_ps();
+    const __m256 vhi     = _mm256_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m128 a = _mm256_cvtpd_ps(_mm256_loadu_pd(values + i));
+        __m128 b = _mm256_cvtpd_ps(_mm256_loadu_pd(values + i + 4));
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+        x = _mm256_add_ps(_mm256_mul_ps(x, vscale), voffset);
+        x = _mm256_min_ps(_mm256_max_ps(x, vlo), vhi); // max first so NaN becomes 0
+        __m256i idx = _mm256_cvttps_epi32(x);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_i32gather_epi32((const int*)lut, idx, 4));
+    }
+#elif defined(COLORIZE_SSE2)
+    const __m128 vscale  = _mm_set1_ps(scale);
+    const __m128 voffset = _mm_set1_ps(offset);
+    const __m128 vlo     = _mm_setzero_ps();
+    const __m128 vhi     = _mm_set1_ps(float(COLORMAP_SIZE - 1));
+    int32_t idx[4];
+    for(; i + 4 <= n; i += 4){
+        __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(values + i));
+        __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(values + i + 2));
+        __m128 x = _mm_movelh_ps(a, b);
+        x = _mm_add_ps(_mm_mul_ps(x, vscale), voffset);
+        x = _mm_min_ps(_mm_max_ps(x, vlo), vhi); // max first so NaN becomes 0
+        _mm_storeu_si128((__m128i*)idx, _mm_cvttps_epi32(x));
+        out[i]     = lut[idx[0]];
+        out[i + 1] = lut[idx[1]];
+        out[i + 2] = lut[idx[2]];
+        out[i + 3] = lut[idx[3]];
+    }
+#elif defined(COLORIZE_NEON)
+    const float32x4_t vscale  = vdupq_n_f32(scale);
+    const float32x4_t voffset = vdupq_n_f32(offset);
+    const float32x4_t vlo     = vdupq_n_f32(0.0f);
+    const float32x4_t vhi     = vdupq_n_f32(float(COLORMAP_SIZE - 1));
+    int32_t idx[4];
+    for(; i + 4 <= n; i += 4){
+#if defined(__aarch64__)
+        float32x4_t x = vcombine_f32(vcvt_f32_f64(vld1q_f64(values + i)),
+                                     vcvt_f32_f64(vld1q_f64(values + i + 2)));
+#else
+        // 32-bit NEON has no double lanes, narrow to float on the way in
+        float f[4] = { float(values[i]), float(values[i + 1]), float(values[i + 2]), float(values[i + 3]) };
+        float32x4_t x = vld1q_f32(f);
+#endif
+        x = vmlaq_f32(voffset, x, vscale);
+        x = vminq_f32(vmaxq_f32(x, vlo), vhi);
+        vst1q_s32(idx, vcvtq_s32_f32(x));
+        out[i]     = lut[idx[0]];
+        out[i + 1] = lut[idx[1]];
+        out[i + 2] = lut[idx[2]];
+        out[i + 3] = lut[idx[3]];
+    }
+#endif
+
+    // leftovers, or the whole row without SIMD
+    for(; i < n; i++){
+        out[i] = lut[colorIndex(values[i], scale, offset)];
+    }
+}
+
+/**
+ * @brief quantizeRow map a whole row of dB values to colormap indices
+ * @param values fft values in dB
+ * @param n number of values
+ * @param min power mapped to index 0
+ * @param max power mapped to index COLORMAP_SIZE - 1
+ * @param out n indices
+ * Indices can be stored instead of pixels (one byte each, and max-hold on them
+ * is max-hold on power) and turned into pixels later with paletteRow.
+ */
+void quantizeRow(const double* values, int n, double min, double max, uint8_t* out){
+    double span = max > min ? max - min : 1.0;
+    float scale = float((COLORMAP_SIZE - 1)/span);
+    float offset = float(0.5 - min*(COLORMAP_SIZE - 1)/span);
+    int i = 0;
+
+#if defined(COLORIZE_AVX2)
+    const __m256 vscale  = _mm256_set1_ps(scale);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    const __m256 vlo     = _mm256_setzero_ps();
+    const __m256 vhi     = _mm256_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m128 a = _mm256_cvtpd_ps(_mm256_loadu_pd(values + i));
+        __m128 b = _mm256_cvtpd_ps(_mm256_loadu_pd(values + i + 4));
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+        x = _mm256_add_ps(_mm256_mul_ps(x, vscale), voffset);
+        x = _mm256_min_ps(_mm256_max_ps(x, vlo), vhi);
+        __m256i idx = _mm256_cvttps_epi32(x);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(idx), _mm256_extracti128_si256(idx, 1));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#elif defined(COLORIZE_SSE2)
+    const __m128 vscale  = _mm_set1_ps(scale);
+    const __m128 voffset = _mm_set1_ps(offset);
+    const __m128 vlo     = _mm_setzero_ps();
+    const __m128 vhi     = _mm_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m128 x0 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(values + i)),     _mm_cvtpd_ps(_mm_loadu_pd(values + i + 2)));
+        __m128 x1 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(values + i + 4)), _mm_cvtpd_ps(_mm_loadu_pd(values + i + 6)));
+        x0 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(x0, vscale), voffset), vlo), vhi);
+        x1 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(x1, vscale), voffset), vlo), vhi);
+        __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(x0), _mm_cvttps_epi32(x1));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#elif defined(COLORIZE_NEON)
+    const float32x4_t vscale  = vdupq_n_f32(scale);
+    const float32x4_t voffset = vdupq_n_f32(offset);
+    const float32x4_t vlo     = vdupq_n_f32(0.0f);
+    const float32x4_t vhi     = vdupq_n_f32(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+#if defined(__aarch64__)
+        float32x4_t x0 = vcombine_f32(vcvt_f32_f64(vld1q_f64(values + i)),     vcvt_f32_f64(vld1q_f64(values + i + 2)));
+        float32x4_t x1 = vcombine_f32(vcvt_f32_f64(vld1q_f64(values + i + 4)), vcvt_f32_f64(vld1q_f64(values + i + 6)));
+#else
+        float f[8];
+        for(int k = 0; k < 8; k++){
+            f[k] = float(values[i + k]);
+        }
+        float32x4_t x0 = vld1q_f32(f);
+        float32x4_t x1 = vld1q_f32(f + 4);
+#endif
+        x0 = vminq_f32(vmaxq_f32(vmlaq_f32(voffset, x0, vscale), vlo), vhi);
+        x1 = vminq_f32(vmaxq_f32(vmlaq_f32(voffset, x1, vscale), vlo), vhi);
+        int16x8_t words = vcombine_s16(vmovn_s32(vcvtq_s32_f32(x0)), vmovn_s32(vcvtq_s32_f32(x1)));
+        vst1_u8(out + i, vqmovun_s16(words));
+    }
+#endif
+
+    for(; i < n; i++){
+        out[i] = uint8_t(colorIndex(values[i], scale, offset));
+    }
+}
+
+/**
+ * @brief quantizeRow map a whole row of float dB values to colormap indices
+ * @param values fft values in dB
+ * @param n number of values
+ * @param min power mapped to index 0
+ * @param max power mapped to index COLORMAP_SIZE - 1
+ * @param out n indices
+ * half the memory traffic of the double version and no narrowing on the way in
+ */
+void quantizeRow(const float* values, int n, double min, double max, uint8_t* out){
+    double span = max > min ? max - min : 1.0;
+    float scale = float((COLORMAP_SIZE - 1)/span);
+    float offset = float(0.5 - min*(COLORMAP_SIZE - 1)/span);
+    int i = 0;
+
+#if defined(COLORIZE_AVX2)
+    const __m256 vscale  = _mm256_set1_ps(scale);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    const __m256 vlo     = _mm256_setzero_ps();
+    const __m256 vhi     = _mm256_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(values + i), vscale), voffset);
+        x = _mm256_min_ps(_mm256_max_ps(x, vlo), vhi);
+        __m256i idx = _mm256_cvttps_epi32(x);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(idx), _mm256_extracti128_si256(idx, 1));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#elif defined(COLORIZE_SSE2)
+    const __m128 vscale  = _mm_set1_ps(scale);
+    const __m128 voffset = _mm_set1_ps(offset);
+    const __m128 vlo     = _mm_setzero_ps();
+    const __m128 vhi     = _mm_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m128 x0 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(values + i), vscale), voffset), vlo), vhi);
+        __m128 x1 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(values + i + 4), vscale), voffset), vlo), vhi);
+        __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(x0), _mm_cvttps_epi32(x1));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#elif defined(COLORIZE_NEON)
+    const float32x4_t vscale  = vdupq_n_f32(scale);
+    const float32x4_t voffset = vdupq_n_f32(offset);
+    const float32x4_t vlo     = vdupq_n_f32(0.0f);
+    const float32x4_t vhi     = vdupq_n_f32(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        float32x4_t x0 = vminq_f32(vmaxq_f32(vmlaq_f32(voffset, vld1q_f32(values + i), vscale), vlo), vhi);
+        float32x4_t x1 = vminq_f32(vmaxq_f32(vmlaq_f32(voffset, vld1q_f32(values + i + 4), vscale), vlo), vhi);
+        int16x8_t words = vcombine_s16(vmovn_s32(vcvtq_s32_f32(x0)), vmovn_s32(vcvtq_s32_f32(x1)));
+        vst1_u8(out + i, vqmovun_s16(words));
+    }
+#endif
+
+    for(; i < n; i++){
+        out[i] = uint8_t(colorIndex(values[i], scale, offset));
+    }
+}
+
+/**
+ * @brief quantizeRow map a whole row of centi-dB values to colormap indices
+ * @param values fft values in hundredths of a dB
+ * @param n number of values
+ * @param min power in dB mapped to index 0
+ * @param max power in dB mapped to index COLORMAP_SIZE - 1
+ * @param out n indices
+ * the centi-dB scale is folded into the multiplier, a quarter of the memory traffic of doubles
+ */
+void quantizeRow(const int16_t* values, int n, double min, double max, uint8_t* out){
+    double span = max > min ? max - min : 1.0;
+    float scale = float((COLORMAP_SIZE - 1)/span/CENTI_DB_SCALE);
+    float offset = float(0.5 - min*(COLORMAP_SIZE - 1)/span);
+    int i = 0;
+
+#if defined(COLORIZE_AVX2)
+    const __m256 vscale  = _mm256_set1_ps(scale);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    const __m256 vlo     = _mm256_setzero_ps();
+    const __m256 vhi     = _mm256_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(values + i))));
+        x = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(x, vscale), voffset), vlo), vhi);
+        __m256i idx = _mm256_cvttps_epi32(x);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(idx), _mm256_extracti128_si256(idx, 1));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#elif defined(COLORIZE_SSE2)
+    const __m128 vscale  = _mm_set1_ps(scale);
+    const __m128 voffset = _mm_set1_ps(offset);
+    const __m128 vlo     = _mm_setzero_ps();
+    const __m128 vhi     = _mm_set1_ps(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        __m128i v = _mm_loadu_si128((const __m128i*)(values + i));
+        // sign extend to 32 bits, SSE2 has no pmovsx
+        __m128 x0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 x1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        x0 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(x0, vscale), voffset), vlo), vhi);
+        x1 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(x1, vscale), voffset), vlo), vhi);
+        __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(x0), _mm_cvttps_epi32(x1));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+    }
+#elif defined(COLORIZE_NEON)
+    const float32x4_t vscale  = vdupq_n_f32(scale);
+    const float32x4_t voffset = vdupq_n_f32(offset);
+    const float32x4_t vlo     = vdupq_n_f32(0.0f);
+    const float32x4_t vhi     = vdupq_n_f32(float(COLORMAP_SIZE - 1));
+    for(; i + 8 <= n; i += 8){
+        int16x8_t v = vld1q_s16(values + i);
+        float32x4_t x0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t x1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        x0 = vminq_f32(vmaxq_f32(vmlaq_f32(voffset, x0, vscale), vlo), vhi);
+        x1 = vminq_f32(vmaxq_f32(vmlaq_f32(voffset, x1, vscale), vlo), vhi);
+        int16x8_t words = vcombine_s16(vmovn_s32(vcvtq_s32_f32(x0)), vmovn_s32(vcvtq_s32_f32(x1)));
+        vst1_u8(out + i, vqmovun_s16(words));
+    }
+#endif
+
+    for(; i < n; i++){
+        out[i] = uint8_t(colorIndex(values[i], scale, offset));
+    }
+}
+
+/**
+ * @brief paletteRow turn a row of colormap indices into packed pixels
+ * @param indices colormap indices from quantizeRow
+ * @param n number of indices
+ * @param lut colormap with COLORMAP_SIZE entries
+ * @param out n pixels
+ */
+void paletteRow(const uint8_t* indices, int n, const uint32_t* lut, uint32_t* out){
+    int i = 0;
+#if defined(COLORIZE_AVX2)
+    for(; i + 8 <= n; i += 8){
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(indices + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_i32gather_epi32((const int*)lut, idx, 4));
+    }
+#endif
+    for(; i < n; i++){
+        out[i] = lut[indices[i]];
+    }
+}
+
+/**
+ * @brief paletteRow16 turn a row of colormap indices into RGB565 pixels
+ * @param indices colormap indices from quantizeRow
+ * @param n number of indices
+ * @param lut colormap with COLORMAP_SIZE RGB565 entries, 512 bytes
+ * @param out n pixels
+ */
+void paletteRow16(const uint8_t* indices, int n, const uint16_t* lut, uint16_t* out){
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        out[i]     = lut[indices[i]];
+        out[i + 1] = lut[indices[i + 1]];
+        out[i + 2] = lut[indices[i + 2]];
+        out[i + 3] = lut[indices[i + 3]];
+    }
+    for(; i < n; i++){
+        out[i] = lut[indices[i]];
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef COLORIZE_H
+#define COLORIZE_H
+
+#include <cstdint>
+#include "sampletype.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define COLORIZE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COLORIZE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COLORIZE_NEON
+#endif
+
+#define COLORMAP_SIZE   256     // entries in the colormap LUT, 1 kB at 32 bpp so it stays in L1
+
+void colorizeRow(const double* values, int n, double min, double max, const uint32_t* lut, uint32_t* out);
+void colorizeRowScalar(const double* values, int n, double min, double max, const uint32_t* lut, uint32_t* out);
+void quantizeRow(const double* values, int n, double min, double max, uint8_t* out);
+void quantizeRow(const float* values, int n, double min, double max, uint8_t* out);
+void quantizeRow(const int16_t* values, int n, double min, double max, uint8_t* out);
+void paletteRow(const uint8_t* indices, int n, const uint32_t* lut, uint32_t* out);
+void paletteRow16(const uint8_t* indices, int n, const uint16_t* lut, uint16_t* out);
+
+#endif // COLORIZE_H
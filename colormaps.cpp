@@ -0,0 +1,154 @@
+#include "colormaps.h"
+
+// All palettes are built by the compiler into read-only tables, one per pixel
+// format. C++11 constexpr functions are a single return statement, so every
+// entry is a closed-form expression of its index.
+
+/**
+ * @brief classicChannel one channel of the classic colormap, 0..255
+ * @param x channel level, clipped below at 0
+ */
+constexpr uint32_t classicChannel(double x){
+    return uint32_t((x > 0.0 ? x : 0.0)*255.0 + 0.5);
+}
+
+/**
+ * @brief classicPixel blue fades out over the bottom half, red fades in over the top half
+ * and green peaks in the middle
+ * @param t 0.0 at the min power, 1.0 at the max
+ */
+constexpr uint32_t classicPixel(double t){
+    return 0xFF000000 |
+           classicChannel(2.0*t - 1.0) << 16 |
+           classicChannel(1.0 - (2.0*t - 1.0 > 0.0 ? 2.0*t - 1.0 : 1.0 - 2.0*t)) << 8 |
+           classicChannel(1.0 - 2.0*t);
+}
+
+#define COLORMAP_ANCHORS    16  // evenly spaced samples the perceptual colormaps are interpolated from
+
+// matplotlib's viridis and inferno sampled at k/15
+constexpr uint32_t viridisAnchors[COLORMAP_ANCHORS] = {
+    0x440154, 0x481a6c, 0x472f7d, 0x414487, 0x39568c, 0x31688e, 0x2a788e, 0x23888e,
+    0x1f988b, 0x22a884, 0x35b779, 0x54c568, 0x7ad151, 0xa5db36, 0xd2e21b, 0xfde725
+};
+constexpr uint32_t infernoAnchors[COLORMAP_ANCHORS] = {
+    0x000004, 0x0c0826, 0x240c4f, 0x420a68, 0x5d126e, 0x781c6d, 0x932667, 0xae305c,
+    0xc73e4c, 0xdd513a, 0xed6925, 0xf8850f, 0xfca50a, 0xfac62d, 0xf2e661, 0xfcffa4
+};
+
+/**
+ * @brief lerpChannel interpolate one channel between two packed pixels
+ * @param a pixel at num = 0
+ * @param b pixel at num = den
+ * @param shift bit position of the channel
+ * @param num position between a and b
+ * @param den
+ */
+constexpr uint32_t lerpChannel(uint32_t a, uint32_t b, int shift, int num, int den){
+    return ((((a >> shift) & 0xFF)*uint32_t(den - num) + ((b >> shift) & 0xFF)*uint32_t(num) + uint32_t(den/2))/uint32_t(den)) << shift;
+}
+
+/**
+ * @brief lerpPixel interpolate between two packed pixels
+ */
+constexpr uint32_t lerpPixel(uint32_t a, uint32_t b, int num, int den){
+    return 0xFF000000 | lerpChannel(a, b, 16, num, den) | lerpChannel(a, b, 8, num, den) | lerpChannel(a, b, 0, num, den);
+}
+
+/**
+ * @brief anchoredPixel colormap entry i interpolated from COLORMAP_ANCHORS evenly spaced anchors
+ * @param anchors
+ * @param i colormap index
+ */
+constexpr uint32_t anchoredPixel(const uint32_t* anchors, int i){
+    return i == COLORMAP_SIZE - 1 ?
+           0xFF000000 | anchors[COLORMAP_ANCHORS - 1] :
+           lerpPixel(anchors[i*(COLORMAP_ANCHORS - 1)/(COLORMAP_SIZE - 1)],
+                     anchors[i*(COLORMAP_ANCHORS - 1)/(COLORMAP_SIZE - 1) + 1],
+                     i*(COLORMAP_ANCHORS - 1) % (COLORMAP_SIZE - 1), COLORMAP_SIZE - 1);
+}
+
+/**
+ * @brief colormapPixel entry i of a colormap as a packed 0xffRRGGBB pixel
+ * @param colormap a Colormap
+ * @param i colormap index
+ */
+constexpr uint32_t colormapPixel(int colormap, int i){
+    return colormap == COLORMAP_VIRIDIS   ? anchoredPixel(viridisAnchors, i) :
+           colormap == COLORMAP_INFERNO   ? anchoredPixel(infernoAnchors, i) :
+           colormap == COLORMAP_GRAYSCALE ? 0xFF000000 | uint32_t(i) << 16 | uint32_t(i) << 8 | uint32_t(i) :
+           classicPixel(double(i)/double(COLORMAP_SIZE - 1));
+}
+
+// compile time list of colormap indices, std::index_sequence is C++14
+template<int... I> struct ColormapIndices {};
+template<int N, int... I> struct MakeColormapIndices : MakeColormapIndices<N - 1, N - 1, I...> {};
+template<int... I> struct MakeColormapIndices<0, I...> { typedef ColormapIndices<I...> type; };
+
+template<typename Indices> struct ColormapTables;
+
+/**
+ * @brief The ColormapTables struct expands every colormap over all indices, in every pixel format
+ */
+template<int... I> struct ColormapTables<ColormapIndices<I...>> {
+    static constexpr uint32_t rgb32[COLORMAP_COUNT][COLORMAP_SIZE] = {
+        { colormapPixel(COLORMAP_CLASSIC, I)... },
+        { colormapPixel(COLORMAP_VIRIDIS, I)... },
+        { colormapPixel(COLORMAP_INFERNO, I)... },
+        { colormapPixel(COLORMAP_GRAYSCALE, I)... }
+    };
+    static constexpr uint16_t rgb16[COLORMAP_COUNT][COLORMAP_SIZE] = {
+        { rgb565(colormapPixel(COLORMAP_CLASSIC, I))... },
+        { rgb565(colormapPixel(COLORMAP_VIRIDIS, I))... },
+        { rgb565(colormapPixel(COLORMAP_INFERNO, I))... },
+        { rgb565(colormapPixel(COLORMAP_GRAYSCALE, I))... }
+    };
+};
+
+template<int... I> constexpr uint32_t ColormapTables<ColormapIndices<I...>>::rgb32[COLORMAP_COUNT][COLORMAP_SIZE];
+template<int... I> constexpr uint16_t ColormapTables<ColormapIndices<I...>>::rgb16[COLORMAP_COUNT][COLORMAP_SIZE];
+
+typedef ColormapTables<MakeColormapIndices<COLORMAP_SIZE>::type> Colormaps;
+
+static_assert(Colormaps::rgb32[COLORMAP_CLASSIC][0] == 0xFF0000FF, "classic colormap starts blue");
+static_assert(Colormaps::rgb32[COLORMAP_CLASSIC][COLORMAP_SIZE - 1] == 0xFFFF0000, "classic colormap ends red");
+static_assert(Colormaps::rgb16[COLORMAP_GRAYSCALE][COLORMAP_SIZE - 1] == 0xFFFF, "grayscale colormap ends white");
+
+/**
+ * @brief colormap32 look up a colormap as packed 0xffRRGGBB pixels
+ * @param colormap a Colormap, anything else gives the classic colormap
+ * @return COLORMAP_SIZE entries, read-only and valid for the life of the program
+ */
+const uint32_t* colormap32(int colormap){
+    if(colormap < 0 || colormap >= COLORMAP_COUNT){
+        colormap = COLORMAP_CLASSIC;
+    }
+    return Colormaps::rgb32[colormap];
+}
+
+/**
+ * @brief colormap565 look up a colormap as RGB565 pixels
+ * @param colormap a Colormap, anything else gives the classic colormap
+ * @return COLORMAP_SIZE entries, read-only and valid for the life of the program
+ */
+const uint16_t* colormap565(int colormap){
+    if(colormap < 0 || colormap >= COLORMAP_COUNT){
+        colormap = COLORMAP_CLASSIC;
+    }
+    return Colormaps::rgb16[colormap];
+}
+
+/**
+ * @brief colormapFromName parse a colormap name
+ * @param name "classic", "viridis", "inferno" or "grayscale", lower case
+ * @return a Colormap, or -1 if the name is unknown
+ */
+int colormapFromName(const char* name){
+    static const char* const names[COLORMAP_COUNT] = { "classic", "viridis", "inferno", "grayscale" };
+    for(int i = 0; i < COLORMAP_COUNT; i++){
+        if(strcmp(name, names[i]) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
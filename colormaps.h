@@ -0,0 +1,34 @@
+#ifndef COLORMAPS_H
+#define COLORMAPS_H
+
+#include <cstdint>
+#include <cstring>
+#include "colorize.h"
+
+/**
+ * @brief The Colormap enum lists the palettes built into the program
+ */
+enum Colormap {
+    COLORMAP_CLASSIC,   // blue -> green -> red
+    COLORMAP_VIRIDIS,   // perceptually uniform, readable in grayscale and by most color blind viewers
+    COLORMAP_INFERNO,   // perceptually uniform, black -> purple -> yellow
+    COLORMAP_GRAYSCALE, // black -> white
+    COLORMAP_COUNT
+};
+
+/**
+ * @brief rgb565 convert a packed 0xffRRGGBB pixel to RGB565
+ * @param pixel
+ * @return the nearest RGB565 pixel, each channel rounded rather than truncated
+ */
+constexpr uint16_t rgb565(uint32_t pixel){
+    return uint16_t(((((pixel >> 16) & 0xFF)*31 + 127)/255) << 11 |
+                    ((((pixel >> 8) & 0xFF)*63 + 127)/255) << 5 |
+                    (((pixel & 0xFF)*31 + 127)/255));
+}
+
+const uint32_t* colormap32(int colormap);
+const uint16_t* colormap565(int colormap);
+int colormapFromName(const char* name);
+
+#endif // COLORMAPS_H
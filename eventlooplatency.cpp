@@ -0,0 +1,54 @@
+#include "eventlooplatency.h"
+
+/**
+ * @brief EventLoopLatency::EventLoopLatency constructor
+ * @param parent used for QObject, the probe runs in the parent's thread
+ */
+EventLoopLatency::EventLoopLatency(QObject *parent) :
+    QObject(parent)
+{
+    this->timer = new QTimer(this);
+    this->timer->setTimerType(Qt::PreciseTimer);
+    this->timer->setInterval(LATENCY_TICK_MS);
+    connect(this->timer, &QTimer::timeout, this, &EventLoopLatency::tick);
+}
+
+/**
+ * @brief EventLoopLatency::start begin probing, a report is emitted every LATENCY_WINDOW_MS
+ */
+void EventLoopLatency::start(){
+    this->total = 0.0;
+    this->worst = 0.0;
+    this->samples = 0;
+    this->clock.start();
+    this->window.start();
+    this->timer->start();
+}
+
+/**
+ * @brief EventLoopLatency::stop
+ */
+void EventLoopLatency::stop(){
+    this->timer->stop();
+}
+
+/**
+ * @brief EventLoopLatency::tick record how late this timer event is
+ */
+void EventLoopLatency::tick(){
+    double late = this->clock.nsecsElapsed()/1.0e6 - LATENCY_TICK_MS;
+    this->clock.restart();
+    late = late > 0.0 ? late : 0.0;
+
+    this->total += late;
+    this->worst = late > this->worst ? late : this->worst;
+    this->samples++;
+
+    if(this->window.elapsed() >= LATENCY_WINDOW_MS){
+        emit report(this->total/this->samples, this->worst, this->samples);
+        this->window.restart();
+        this->total = 0.0;
+        this->worst = 0.0;
+        this->samples = 0;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef EVENTLOOPLATENCY_H
+#define EVENTLOOPLATENCY_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#define LATENCY_TICK_MS     10      // expected interval between probe timer events
+#define LATENCY_WINDOW_MS   5000    // ms between reports
+
+/**
+ * @brief The EventLoopLatency class measures how late timer events run on the thread it lives in
+ * A precise timer asks to run every LATENCY_TICK_MS, anything beyond that is time
+ * the event loop spent busy with something else, like painting or decoding.
+ */
+class EventLoopLatency : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EventLoopLatency(QObject *parent = nullptr);
+    void start();
+    void stop();
+
+signals:
+    void report(double meanMs, double maxMs, int samples);
+
+private slots:
+    void tick();
+
+private:
+    QTimer* timer;
+    QElapsedTimer clock;        // time since the previous tick
+    QElapsedTimer window;       // time since the previous report
+    double total = 0.0;         // summed lateness in this window, ms
+    double worst = 0.0;
+    int samples = 0;
+};
+
+#endif // EVENTLOOPLATENCY_H
@@ -0,0 +1,135 @@
+#include "fftframe.h"
+
+FFTFrameRef::FFTFrameRef(const FFTFrameRef& other){
+    this->frame = other.frame;
+    if(this->frame != nullptr){
+        this->frame->refs.ref();
+    }
+}
+
+FFTFrameRef& FFTFrameRef::operator=(const FFTFrameRef& other){
+    if(other.frame != nullptr){
+        other.frame->refs.ref();
+    }
+    this->reset();
+    this->frame = other.frame;
+    return *this;
+}
+
+FFTFrameRef& FFTFrameRef::operator=(FFTFrameRef&& other){
+    if(this != &other){
+        this->reset();
+        this->frame = other.frame;
+        other.frame = nullptr;
+    }
+    return *this;
+}
+
+/**
+ * @brief FFTFrameRef::reset drop this reference, the last one returns the frame to its pool
+ */
+void FFTFrameRef::reset(){
+    if(this->frame != nullptr && !this->frame->refs.deref()){
+        this->frame->pool->recycle(this->frame);
+    }
+    this->frame = nullptr;
+}
+
+/**
+ * @brief FFTFrame::setPayload say where the samples are once the body has been read, before the frame is handed out
+ * @param type sample type of the bins
+ * @param offset bytes from data() to the first bin, a multiple of the sample size
+ * @param bins number of bins, they have to fit in the body
+ * @param info what the producer said about the frame
+ */
+void FFTFrame::setPayload(SampleType type, size_t offset, int bins, const FFTFrameInfo& info){
+    this->type = type;
+    this->offset = offset;
+    this->bins = bins;
+    this->info = info;
+}
+
+FFTFramePool::~FFTFramePool(){
+    while(this->freeList != nullptr){
+        FFTFrame* frame = this->freeList;
+        this->freeList = frame->next;
+        delete frame;
+    }
+}
+
+/**
+ * @brief FFTFramePool::acquire take a frame out of the pool to fill in
+ * @param type sample type of the payload
+ * @param size payload size in bytes, data() has room for this many
+ * @return a frame with one reference, or a null reference if its buffer couldn't be allocated
+ */
+FFTFrameRef FFTFramePool::acquire(SampleType type, size_t size){
+    this->mutex.lock();
+    FFTFrame* frame = this->freeList;
+    if(frame != nullptr){
+        this->freeList = frame->next;
+    }else{
+        frame = new FFTFrame();
+        frame->pool = this;
+        this->frames++;
+    }
+    this->outstanding++;
+    if(frame->capacity < size){
+        this->allocations++;
+    }
+    this->mutex.unlock();
+
+    if(frame->capacity < size){
+        // frames come back in any order, so every buffer grows to the largest payload seen
+        free(frame->buffer);
+        frame->buffer = (char*)malloc(size);
+        if(frame->buffer == nullptr){
+            frame->capacity = 0;
+            this->recycle(frame);
+            return FFTFrameRef();
+        }
+        frame->capacity = size;
+    }
+    frame->size = size;
+    frame->offset = 0;
+    frame->info = FFTFrameInfo();
+    frame->type = type;
+    frame->bins = int(size/sampleSize(type));
+    frame->next = nullptr;
+    frame->refs.storeRelease(1);
+    return FFTFrameRef(frame);
+}
+
+/**
+ * @brief FFTFramePool::recycle put a frame back once its last reference is gone
+ * @param frame
+ */
+void FFTFramePool::recycle(FFTFrame* frame){
+    this->mutex.lock();
+    this->outstanding--;
+    if(this->closed){
+        delete frame;
+        bool last = this->outstanding == 0;
+        this->mutex.unlock();
+        if(last){
+            delete this;
+        }
+        return;
+    }
+    frame->next = this->freeList;
+    this->freeList = frame;
+    this->mutex.unlock();
+}
+
+/**
+ * @brief FFTFramePool::close give up the pool, it is deleted now or when the last frame comes back
+ */
+void FFTFramePool::close(){
+    this->mutex.lock();
+    this->closed = true;
+    bool last = this->outstanding == 0;
+    this->mutex.unlock();
+    if(last){
+        delete this;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef FFTFRAME_H
+#define FFTFRAME_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <cstdlib>
+#include "sampletype.h"
+
+class FFTFramePool;
+
+/**
+ * @brief The FFTFrameInfo struct is what a self-describing frame says about itself
+ * Raw frames leave it zeroed, receivers then go by the tuning they were told about.
+ */
+struct FFTFrameInfo {
+    double center = 0.0;        // center frequency in Hz, 0 if unknown
+    double span = 0.0;          // span of all bins in Hz, 0 if unknown
+    quint64 sequence = 0;       // producer's frame counter
+    qint64 timestamp = 0;       // producer time in microseconds since the epoch, 0 if unknown
+};
+
+/**
+ * @brief The FFTFrame class is one FFT payload as it came off the wire
+ * Frames are only made by an FFTFramePool and handed around through FFTFrameRef,
+ * the last reference puts the frame back in its pool with its buffer kept.
+ */
+class FFTFrame
+{
+public:
+    char* data() { return buffer; }
+    const char* constData() const { return buffer; }
+    template<typename T> const T* samples() const { return (const T*)(buffer + offset); }
+    template<typename T> T* mutableSamples() { return (T*)(buffer + offset); }
+    size_t getSize() const { return size; }
+    int getBins() const { return bins; }
+    SampleType getType() const { return type; }
+    const FFTFrameInfo& getInfo() const { return info; }
+    void setPayload(SampleType type, size_t offset, int bins, const FFTFrameInfo& info);
+
+private:
+    friend class FFTFramePool;
+    friend class FFTFrameRef;
+    FFTFrame() {}
+    ~FFTFrame() { free(buffer); }
+    char* buffer = nullptr;
+    size_t size = 0;            // bytes of payload
+    size_t capacity = 0;        // bytes allocated
+    size_t offset = 0;          // bytes before the first sample, a wire header
+    int bins = 0;
+    SampleType type = SAMPLE_DOUBLE;
+    FFTFrameInfo info;
+    QAtomicInt refs;
+    FFTFramePool* pool = nullptr;
+    FFTFrame* next = nullptr;   // free list link while in the pool
+};
+
+/**
+ * @brief The FFTFrameRef class is a counted handle to an FFTFrame, cheap to copy and pass through a FrameQueue
+ * Copies share the frame, nobody writes to a frame once it has been handed out.
+ */
+class FFTFrameRef
+{
+public:
+    FFTFrameRef() {}
+    FFTFrameRef(const FFTFrameRef& other);
+    FFTFrameRef(FFTFrameRef&& other) : frame(other.frame) { other.frame = nullptr; }
+    ~FFTFrameRef() { reset(); }
+    FFTFrameRef& operator=(const FFTFrameRef& other);
+    FFTFrameRef& operator=(FFTFrameRef&& other);
+    FFTFrame* operator->() const { return frame; }
+    FFTFrame* get() const { return frame; }
+    bool isNull() const { return frame == nullptr; }
+    void reset();
+
+private:
+    friend class FFTFramePool;
+    friend class FrameQueue;
+    explicit FFTFrameRef(FFTFrame* frame) : frame(frame) {}   // adopts a reference already counted
+    FFTFrame* frame = nullptr;
+};
+
+/**
+ * @brief The FFTFramePool class recycles FFT frames and their buffers
+ * Once as many frames exist as are in flight at a time, acquiring a frame
+ * allocates nothing. Frames may be released from any thread.
+ * The pool is not deleted but closed, it frees itself once its last frame is back.
+ */
+class FFTFramePool
+{
+public:
+    FFTFramePool() {}
+    FFTFrameRef acquire(SampleType type, size_t size);
+    void close();
+    int getFrames() { return frames; }
+    quint64 getAllocations() { return allocations; }
+
+private:
+    friend class FFTFrameRef;
+    ~FFTFramePool();
+    void recycle(FFTFrame* frame);
+    QMutex mutex;
+    FFTFrame* freeList = nullptr;
+    int frames = 0;             // frames created, in the pool or out
+    int outstanding = 0;        // frames out of the pool
+    quint64 allocations = 0;    // buffer allocations and reallocations, flat once warmed up
+    bool closed = false;
+};
+
+#endif // FFTFRAME_H
@@ -0,0 +1,356 @@
+#include "fftwire.h"
+
+/**
+ * @brief isFFTWireContentType
+ * @param contentType message content type
+ * @return true for "application/x-sdr-fft", with or without parameters
+ */
+bool isFFTWireContentType(const char* contentType){
+    static const char base[] = FFT_WIRE_CONTENT_TYPE;
+    if(strncmp(contentType, base, sizeof(base) - 1) != 0){
+        return false;
+    }
+    char next = contentType[sizeof(base) - 1];
+    return next == '\0' || next == ';' || next == ' ';
+}
+
+/**
+ * @brief fftWireTypeName
+ * @param type
+ * @return the name used for the type in the fftFormat config, "f64", "f32", "cdb16" or "u8"
+ */
+const char* fftWireTypeName(FFTWireType type){
+    switch(type){
+    case FFT_WIRE_F32:
+        return "f32";
+    case FFT_WIRE_CDB16:
+        return "cdb16";
+    case FFT_WIRE_U8:
+        return "u8";
+    default:
+        return "f64";
+    }
+}
+
+/**
+ * @brief fftWireFormatFromName
+ * @param name "f64", "f32", "cdb16" or "u8"
+ * @param type set to the matching type
+ * @return false for an unknown name
+ */
+bool fftWireFormatFromName(const char* name, FFTWireType* type){
+    for(int t = FFT_WIRE_F64; t <= FFT_WIRE_U8; t++){
+        if(strcmp(name, fftWireTypeName(FFTWireType(t))) == 0){
+            *type = FFTWireType(t);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief fftWireSampleSize
+ * @param type
+ * @return bytes per bin
+ */
+int fftWireSampleSize(FFTWireType type){
+    switch(type){
+    case FFT_WIRE_F32:
+        return 4;
+    case FFT_WIRE_CDB16:
+        return 2;
+    case FFT_WIRE_U8:
+        return 1;
+    default:
+        return 8;
+    }
+}
+
+/**
+ * @brief parseFFTWireHeader read and check the header of a wire frame
+ * @param data the whole message body
+ * @param size body size in bytes
+ * @param encoded the bins are compressed, so only the header has to fit
+ * @param header filled in from the body
+ * @return false if the body is not a frame this version can read, has more than FFT_WIRE_MAX_BINS bins,
+ * or is too short for its bins
+ */
+bool parseFFTWireHeader(const char* data, size_t size, bool encoded, FFTWireHeader* header){
+    if(size < FFT_WIRE_HEADER_SIZE){
+        return false;
+    }
+    memcpy(header, data, FFT_WIRE_HEADER_SIZE);   // the body is only byte aligned
+    if(header->magic != FFT_WIRE_MAGIC || header->version < 1){
+        return false;
+    }
+    if(header->headerSize < FFT_WIRE_HEADER_SIZE || header->headerSize % 8 != 0){
+        return false;
+    }
+    if(header->sampleType > FFT_WIRE_U8){
+        return false;
+    }
+    if(header->bins == 0 || header->bins > FFT_WIRE_MAX_BINS || header->headerSize > size){
+        return false;
+    }
+    uint64_t payload = uint64_t(header->bins)*fftWireSampleSize(FFTWireType(header->sampleType));
+    return encoded || header->headerSize + payload <= size;
+}
+
+/**
+ * @brief widenScaledBytes convert uint8 scaled bins to dB floats
+ * @param src n bytes
+ * @param n
+ * @param min dB of the value 0
+ * @param step dB per count
+ * @param dest n floats
+ */
+void widenScaledBytes(const uint8_t* src, int n, float min, float step, float* dest){
+    int i = 0;
+
+#if defined(COLORIZE_AVX2)
+    const __m256 vmin  = _mm256_set1_ps(min);
+    const __m256 vstep = _mm256_set1_ps(step);
+    for(; i + 8 <= n; i += 8){
+        __m128i bytes = _mm_loadl_epi64((const __m128i*)(src + i));
+        __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        _mm256_storeu_ps(dest + i, _mm256_add_ps(vmin, _mm256_mul_ps(v, vstep)));
+    }
+#elif defined(COLORIZE_SSE2)
+    const __m128 vmin  = _mm_set1_ps(min);
+    const __m128 vstep = _mm_set1_ps(step);
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= n; i += 16){
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128 v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+        __m128 v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+        __m128 v2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+        __m128 v3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+        _mm_storeu_ps(dest + i,      _mm_add_ps(vmin, _mm_mul_ps(v0, vstep)));
+        _mm_storeu_ps(dest + i + 4,  _mm_add_ps(vmin, _mm_mul_ps(v1, vstep)));
+        _mm_storeu_ps(dest + i + 8,  _mm_add_ps(vmin, _mm_mul_ps(v2, vstep)));
+        _mm_storeu_ps(dest + i + 12, _mm_add_ps(vmin, _mm_mul_ps(v3, vstep)));
+    }
+#elif defined(COLORIZE_NEON)
+    const float32x4_t vmin = vdupq_n_f32(min);
+    for(; i + 8 <= n; i += 8){
+        uint16x8_t wide = vmovl_u8(vld1_u8(src + i));
+        float32x4_t v0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide)));
+        float32x4_t v1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(wide)));
+        vst1q_f32(dest + i,     vmlaq_n_f32(vmin, v0, step));
+        vst1q_f32(dest + i + 4, vmlaq_n_f32(vmin, v1, step));
+    }
+#endif
+
+    for(; i < n; i++){
+        dest[i] = min + src[i]*step;
+    }
+}
+
+/**
+ * @brief unshuffleBytes put byte planes back together into samples
+ * @param src width planes of n bytes, plane k holds byte k of every sample
+ * @param n number of samples
+ * @param width bytes per sample
+ * @param dest n samples of width bytes
+ */
+void unshuffleBytes(const uint8_t* src, int n, int width, uint8_t* dest){
+    int i = 0;
+
+#if defined(COLORIZE_AVX2) || defined(COLORIZE_SSE2)
+    if(width == 2){
+        for(; i + 16 <= n; i += 16){
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(src + n + i));
+            _mm_storeu_si128((__m128i*)(dest + 2*i),      _mm_unpacklo_epi8(b0, b1));
+            _mm_storeu_si128((__m128i*)(dest + 2*i + 16), _mm_unpackhi_epi8(b0, b1));
+        }
+    }else if(width == 4){
+        for(; i + 16 <= n; i += 16){
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(src + n + i));
+            __m128i b2 = _mm_loadu_si128((const __m128i*)(src + 2*n + i));
+            __m128i b3 = _mm_loadu_si128((const __m128i*)(src + 3*n + i));
+            __m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+            __m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+            __m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+            __m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+            _mm_storeu_si128((__m128i*)(dest + 4*i),      _mm_unpacklo_epi16(lo01, lo23));
+            _mm_storeu_si128((__m128i*)(dest + 4*i + 16), _mm_unpackhi_epi16(lo01, lo23));
+            _mm_storeu_si128((__m128i*)(dest + 4*i + 32), _mm_unpacklo_epi16(hi01, hi23));
+            _mm_storeu_si128((__m128i*)(dest + 4*i + 48), _mm_unpackhi_epi16(hi01, hi23));
+        }
+    }
+#elif defined(COLORIZE_NEON)
+    if(width == 2){
+        for(; i + 16 <= n; i += 16){
+            uint8x16x2_t v;
+            v.val[0] = vld1q_u8(src + i);
+            v.val[1] = vld1q_u8(src + n + i);
+            vst2q_u8(dest + 2*i, v);
+        }
+    }else if(width == 4){
+        for(; i + 16 <= n; i += 16){
+            uint8x16x4_t v;
+            v.val[0] = vld1q_u8(src + i);
+            v.val[1] = vld1q_u8(src + n + i);
+            v.val[2] = vld1q_u8(src + 2*n + i);
+            v.val[3] = vld1q_u8(src + 3*n + i);
+            vst4q_u8(dest + 4*i, v);
+        }
+    }
+#endif
+
+    for(; i < n; i++){
+        for(int k = 0; k < width; k++){
+            dest[i*width + k] = src[k*n + i];
+        }
+    }
+}
+
+/**
+ * @brief undoDelta add the previous frame back onto delta coded bins
+ * @param type sample type of the bins, says whether to add or xor
+ * @param previous n bins of the previous frame
+ * @param n number of bins
+ * @param values n deltas in, n bins out
+ */
+void undoDelta(FFTWireType type, const uint8_t* previous, int n, uint8_t* values){
+    int bytes = n*fftWireSampleSize(type);
+    int i = 0;
+    if(type == FFT_WIRE_CDB16){
+        // bytes is even, the int16 tail is done two bytes at a time below
+#if defined(COLORIZE_AVX2) || defined(COLORIZE_SSE2)
+        for(; i + 16 <= bytes; i += 16){
+            __m128i p = _mm_loadu_si128((const __m128i*)(previous + i));
+            __m128i v = _mm_loadu_si128((const __m128i*)(values + i));
+            _mm_storeu_si128((__m128i*)(values + i), _mm_add_epi16(p, v));
+        }
+#elif defined(COLORIZE_NEON)
+        for(; i + 16 <= bytes; i += 16){
+            vst1q_u16((uint16_t*)(values + i), vaddq_u16(vld1q_u16((const uint16_t*)(previous + i)),
+                                                         vld1q_u16((const uint16_t*)(values + i))));
+        }
+#endif
+        for(; i < bytes; i += 2){
+            uint16_t p, v;
+            memcpy(&p, previous + i, 2);
+            memcpy(&v, values + i, 2);
+            v = uint16_t(p + v);
+            memcpy(values + i, &v, 2);
+        }
+    }else if(type == FFT_WIRE_U8){
+#if defined(COLORIZE_AVX2) || defined(COLORIZE_SSE2)
+        for(; i + 16 <= bytes; i += 16){
+            __m128i p = _mm_loadu_si128((const __m128i*)(previous + i));
+            __m128i v = _mm_loadu_si128((const __m128i*)(values + i));
+            _mm_storeu_si128((__m128i*)(values + i), _mm_add_epi8(p, v));
+        }
+#elif defined(COLORIZE_NEON)
+        for(; i + 16 <= bytes; i += 16){
+            vst1q_u8(values + i, vaddq_u8(vld1q_u8(previous + i), vld1q_u8(values + i)));
+        }
+#endif
+        for(; i < bytes; i++){
+            values[i] = uint8_t(previous[i] + values[i]);
+        }
+    }else{
+        // floats are xored, bytewise is the same thing
+#if defined(COLORIZE_AVX2) || defined(COLORIZE_SSE2)
+        for(; i + 16 <= bytes; i += 16){
+            __m128i p = _mm_loadu_si128((const __m128i*)(previous + i));
+            __m128i v = _mm_loadu_si128((const __m128i*)(values + i));
+            _mm_storeu_si128((__m128i*)(values + i), _mm_xor_si128(p, v));
+        }
+#elif defined(COLORIZE_NEON)
+        for(; i + 16 <= bytes; i += 16){
+            vst1q_u8(values + i, veorq_u8(vld1q_u8(previous + i), vld1q_u8(values + i)));
+        }
+#endif
+        for(; i < bytes; i++){
+            values[i] ^= previous[i];
+        }
+    }
+}
+
+FFTWireInflater::FFTWireInflater(){
+    memset(&this->stream, 0, sizeof(this->stream));
+    this->streamOk = inflateInit(&this->stream) == Z_OK;
+}
+
+FFTWireInflater::~FFTWireInflater(){
+    if(this->streamOk){
+        inflateEnd(&this->stream);
+    }
+    free(this->shuffled);
+    free(this->previous);
+}
+
+/**
+ * @brief FFTWireInflater::reserve grow a buffer, it never shrinks
+ * @return false if out of memory
+ */
+bool FFTWireInflater::reserve(uint8_t** buffer, size_t* capacity, size_t size){
+    if(*capacity >= size){
+        return true;
+    }
+    uint8_t* grown = (uint8_t*)realloc(*buffer, size);
+    if(grown == nullptr){
+        return false;
+    }
+    *buffer = grown;
+    *capacity = size;
+    return true;
+}
+
+/**
+ * @brief FFTWireInflater::decode unpack the bins of one x-sdr-delta-zlib frame
+ * @param header the frame's header, already checked
+ * @param data compressed bins, what follows the header
+ * @param size bytes of compressed bins
+ * @param dest bins*sample size bytes for the plain bins
+ * @return false if the stream is corrupt or a delta frame has nothing to apply to
+ */
+bool FFTWireInflater::decode(const FFTWireHeader& header, const char* data, size_t size, char* dest){
+    FFTWireType type = FFTWireType(header.sampleType);
+    int width = fftWireSampleSize(type);
+    int n = int(header.bins);
+    size_t bytes = size_t(n)*width;
+
+    bool delta = header.flags & FFT_WIRE_FLAG_DELTA;
+    if(delta && !(this->havePrevious && header.sequence == this->previousSequence + 1 &&
+                  header.sampleType == this->previousType && header.bins == this->previousBins)){
+        this->havePrevious = false;
+        return false;
+    }
+    if(!this->streamOk || !this->reserve(&this->shuffled, &this->shuffledCapacity, bytes) ||
+       !this->reserve(&this->previous, &this->previousCapacity, bytes)){
+        return false;
+    }
+
+    // single byte bins have nothing to shuffle, inflate straight into place
+    uint8_t* planes = width == 1 ? (uint8_t*)dest : this->shuffled;
+    inflateReset(&this->stream);
+    this->stream.next_in = (Bytef*)data;
+    this->stream.avail_in = uInt(size);
+    this->stream.next_out = planes;
+    this->stream.avail_out = uInt(bytes);
+    if(inflate(&this->stream, Z_FINISH) != Z_STREAM_END || this->stream.total_out != bytes){
+        this->havePrevious = false;
+        return false;
+    }
+    if(width > 1){
+        unshuffleBytes(planes, n, width, (uint8_t*)dest);
+    }
+    if(delta){
+        undoDelta(type, this->previous, n, (uint8_t*)dest);
+    }
+
+    memcpy(this->previous, dest, bytes);
+    this->havePrevious = true;
+    this->previousSequence = header.sequence;
+    this->previousType = header.sampleType;
+    this->previousBins = header.bins;
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef FFTWIRE_H
+#define FFTWIRE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <zlib.h>
+#include "colorize.h"
+#include "sampletype.h"
+
+#define FFT_WIRE_MAGIC          0x54464653u     // "SFFT" as the first four bytes
+#define FFT_WIRE_VERSION        1
+#define FFT_WIRE_HEADER_SIZE    56              // bytes of a version 1 header, later versions may append fields
+#define FFT_WIRE_MAX_BINS       (1 << 20)       // larger frames are refused, the header could ask for gigabytes
+#define FFT_WIRE_CONTENT_TYPE   "application/x-sdr-fft"
+#define FFT_WIRE_ENCODING       "x-sdr-delta-zlib"  // Content-encoding of compressed frames
+#define FFT_WIRE_FLAG_DELTA     0x01                // encoded bins are relative to the previous frame
+
+/**
+ * @brief The FFTWireType enum is the sample type byte of a wire frame
+ * The first three are the app's own sample types and are used in place,
+ * uint8 is scaled by the header and widened to floats on arrival.
+ */
+enum FFTWireType {
+    FFT_WIRE_F64    = 0,    // 8 byte IEEE doubles in dB
+    FFT_WIRE_F32    = 1,    // 4 byte IEEE floats in dB
+    FFT_WIRE_CDB16  = 2,    // 2 byte signed hundredths of a dB
+    FFT_WIRE_U8     = 3     // 1 byte, dB = scaleMin + value*scaleStep
+};
+
+/**
+ * @brief The FFTWireHeader struct starts every application/x-sdr-fft message, the packed bins follow it
+ * All fields are little endian. headerSize is where the bins start, so a reader
+ * skips fields added by later versions, it is always a multiple of 8 to keep
+ * the bins aligned.
+ */
+struct FFTWireHeader {
+    uint32_t magic;         // FFT_WIRE_MAGIC
+    uint16_t version;       // FFT_WIRE_VERSION of the producer
+    uint16_t headerSize;    // bytes before the first bin
+    uint8_t  sampleType;    // FFTWireType
+    uint8_t  flags;         // FFT_WIRE_FLAG_*, 0 for plain frames
+    uint16_t reserved;      // 0
+    uint32_t bins;          // number of bins
+    double   center;        // center frequency in Hz
+    double   span;          // frequency span of all bins in Hz
+    uint64_t sequence;      // counts up by one per frame, gaps are frames lost on the way
+    int64_t  timestamp;     // producer time in microseconds since the epoch
+    float    scaleMin;      // uint8 only, dB of the value 0
+    float    scaleStep;     // uint8 only, dB per count
+};
+
+static_assert(sizeof(FFTWireHeader) == FFT_WIRE_HEADER_SIZE, "FFTWireHeader must match the wire layout");
+
+bool isFFTWireContentType(const char* contentType);
+bool fftWireFormatFromName(const char* name, FFTWireType* type);
+const char* fftWireTypeName(FFTWireType type);
+int fftWireSampleSize(FFTWireType type);
+bool parseFFTWireHeader(const char* data, size_t size, bool encoded, FFTWireHeader* header);
+void widenScaledBytes(const uint8_t* src, int n, float min, float step, float* dest);
+void unshuffleBytes(const uint8_t* src, int n, int width, uint8_t* dest);
+void undoDelta(FFTWireType type, const uint8_t* previous, int n, uint8_t* values);
+
+/**
+ * @brief The FFTWireInflater class decodes the bins of x-sdr-delta-zlib frames
+ * With that Content-encoding the header is sent as is and the bins are packed as
+ *  1. delta, each bin minus the same bin of the previous frame, integer types
+ *     subtract with wraparound, float types xor their bit patterns so it is lossless,
+ *     frames without FFT_WIRE_FLAG_DELTA are key frames and are not delta coded
+ *  2. shuffle, the first byte of every bin, then the second byte of every bin, ...
+ *  3. a zlib stream
+ * A delta frame only decodes right after the frame before it, after a gap
+ * frames are refused until the next key frame.
+ * The zlib state and the buffers are kept, so once warmed up decoding allocates nothing.
+ */
+class FFTWireInflater
+{
+public:
+    FFTWireInflater();
+    ~FFTWireInflater();
+    bool decode(const FFTWireHeader& header, const char* data, size_t size, char* dest);
+
+private:
+    bool reserve(uint8_t** buffer, size_t* capacity, size_t size);
+    z_stream stream;
+    bool streamOk = false;
+    uint8_t* shuffled = nullptr;    // inflated bins, byte planes
+    size_t shuffledCapacity = 0;
+    uint8_t* previous = nullptr;    // the last frame's bins, what deltas apply to
+    size_t previousCapacity = 0;
+    bool havePrevious = false;
+    uint64_t previousSequence = 0;
+    uint8_t previousType = 0;
+    uint32_t previousBins = 0;
+};
+
+#endif // FFTWIRE_H
@@ -0,0 +1,140 @@
+#include "framebuffer.h"
+
+Framebuffer::Framebuffer(){
+}
+
+Framebuffer::~Framebuffer(){
+    this->close();
+}
+
+/**
+ * @brief Framebuffer::open map a framebuffer device, or a file standing in for one
+ * @param path e.g. /dev/fb0
+ * @param width screen width in pixels, only used if path is not a framebuffer device
+ * @param height screen height in pixels, only used if path is not a framebuffer device
+ * @param depth bits per pixel, 16 or 32, only used if path is not a framebuffer device
+ * @return false if the file can't be mapped or its pixel format isn't RGB565 or XRGB8888
+ */
+bool Framebuffer::open(const QString& path, int width, int height, int depth){
+    this->close();
+
+    this->file.setFileName(path);
+    if(!this->file.open(QIODevice::ReadWrite)){
+        return false;
+    }
+
+    int stride = 0;
+    int redOffset = 16;
+    int xoffset = 0;
+    int yoffset = 0;
+    qint64 size = 0;
+#ifdef __linux__
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+    if(ioctl(this->file.handle(), FBIOGET_VSCREENINFO, &var) == 0 &&
+       ioctl(this->file.handle(), FBIOGET_FSCREENINFO, &fix) == 0){
+        this->device = true;
+        width = int(var.xres);
+        height = int(var.yres);
+        depth = int(var.bits_per_pixel);
+        redOffset = int(var.red.offset);
+        xoffset = int(var.xoffset);   // the visible screen may be panned within a larger virtual one
+        yoffset = int(var.yoffset);
+        stride = int(fix.line_length);
+        size = qint64(fix.smem_len);
+    }
+#endif
+    if(!this->device){
+        // a regular file, laid out like a framebuffer of the given geometry
+        stride = width*depth/8;
+        size = qint64(stride)*height;
+        if(this->file.size() < size && !this->file.resize(size)){
+            this->close();
+            return false;
+        }
+    }
+
+    this->format = Framebuffer::formatFor(depth, redOffset);
+    if(this->format == QImage::Format_Invalid || width <= 0 || height <= 0 || size <= 0){
+        this->close();
+        return false;
+    }
+
+#ifdef __linux__
+    if(this->device){
+        // QFile::map expects a regular file with a size, map the device directly
+        void* address = mmap(nullptr, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, this->file.handle(), 0);
+        this->memory = address == MAP_FAILED ? nullptr : (uchar*)address;
+    }else
+#endif
+    {
+        this->memory = this->file.map(0, size);
+    }
+    if(this->memory == nullptr){
+        this->close();
+        return false;
+    }
+    uchar* visible = this->memory + qint64(yoffset)*stride + xoffset*depth/8;
+    this->image = QImage(visible, width, height, stride, this->format);
+    this->mapped = size;
+    return true;
+}
+
+/**
+ * @brief Framebuffer::close unmap and close the framebuffer
+ */
+void Framebuffer::close(){
+    this->image = QImage();
+    if(this->memory != nullptr){
+#ifdef __linux__
+        if(this->device){
+            munmap(this->memory, size_t(this->mapped));
+        }else
+#endif
+        {
+            this->file.unmap(this->memory);
+        }
+        this->memory = nullptr;
+    }
+    if(this->file.isOpen()){
+        this->file.close();
+    }
+    this->device = false;
+    this->format = QImage::Format_Invalid;
+}
+
+/**
+ * @brief Framebuffer::formatFor the QImage format matching a framebuffer layout
+ * @param depth bits per pixel
+ * @param redOffset bit position of the red channel
+ * @return Format_RGB16, Format_RGB32 or Format_RGBX8888, Format_Invalid for anything else
+ */
+QImage::Format Framebuffer::formatFor(int depth, int redOffset){
+    if(depth == 16){
+        return QImage::Format_RGB16;
+    }
+    if(depth == 32){
+        return redOffset == 0 ? QImage::Format_RGBX8888 : QImage::Format_RGB32;
+    }
+    return QImage::Format_Invalid;
+}
+
+/**
+ * @brief Framebuffer::parseGeometry read a "WIDTHxHEIGHTxDEPTH" string, e.g. "800x480x16"
+ * @param geometry
+ * @param width
+ * @param height
+ * @param depth bits per pixel
+ * @return false if the string is malformed
+ */
+bool Framebuffer::parseGeometry(const QString& geometry, int* width, int* height, int* depth){
+    QStringList parts = geometry.split('x');
+    if(parts.size() != 3){
+        return false;
+    }
+    bool ok[3] = { false, false, false };
+    *width = parts[0].toInt(&ok[0]);
+    *height = parts[1].toInt(&ok[1]);
+    *depth = parts[2].toInt(&ok[2]);
+    return ok[0] && ok[1] && ok[2];
+}
@@ -0,0 +1,45 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QPoint>
+
+#ifdef __linux__
+#include <linux/fb.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#endif
+
+/**
+ * @brief The Framebuffer class maps a framebuffer device for drawing without Qt's backing store
+ * The geometry and pixel format come from the device. A regular file can stand
+ * in for the device, it is then given the geometry passed to open and grown to fit.
+ * The mapping is shared, whatever is drawn into getImage() is on screen.
+ */
+class Framebuffer
+{
+public:
+    Framebuffer();
+    ~Framebuffer();
+    bool open(const QString& path, int width = 0, int height = 0, int depth = 0);
+    void close();
+    bool isOpen() { return memory != nullptr; }
+    bool isDevice() { return device; }
+    QImage::Format getFormat() { return format; }
+    QImage& getImage() { return image; }
+    static bool parseGeometry(const QString& geometry, int* width, int* height, int* depth);
+
+private:
+    static QImage::Format formatFor(int depth, int redOffset);
+    QFile file;
+    uchar* memory = nullptr;    // start of the mapping
+    qint64 mapped = 0;          // bytes mapped
+    bool device = false;        // geometry came from the framebuffer driver
+    QImage::Format format = QImage::Format_Invalid;
+    QImage image;               // the visible screen, wraps memory without copying
+};
+
+#endif // FRAMEBUFFER_H
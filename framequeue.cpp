@@ -0,0 +1,133 @@
+#include "framequeue.h"
+
+/**
+ * @brief FrameQueue::FrameQueue constructor
+ * @param policy what to do when the consumer falls behind
+ * @param capacity frames held at most, rounded up to a power of two, latest always holds one
+ * @param parent
+ */
+FrameQueue::FrameQueue(FrameQueuePolicy policy, int capacity, QObject *parent) :
+    QObject(parent),
+    policy(policy)
+{
+    int size = 1;
+    if(policy != FRAME_QUEUE_LATEST){
+        while(size < capacity){
+            size <<= 1;
+        }
+    }
+    this->capacity = size;
+    this->mask = quint32(size - 1);
+    this->slots = new QAtomicPointer<FFTFrame>[size];
+}
+
+FrameQueue::~FrameQueue(){
+    FFTFrameRef frame;
+    while(this->pop(frame)){
+        frame.reset();
+    }
+    delete[] this->slots;
+}
+
+/**
+ * @brief FrameQueue::push queue a frame for the consumer, producer thread only
+ * @param frame shared with the consumer, not copied
+ * @return false if the queue was closed while waiting for room
+ */
+bool FrameQueue::push(const FFTFrameRef& frame){
+    if(frame.isNull()){
+        return false;
+    }
+    quint32 t = this->tail.loadAcquire();
+
+    if(this->policy == FRAME_QUEUE_BLOCK){
+        bool waited = false;
+        forever{
+            // stale permits first, then look, so a read after the look still wakes the wait
+            this->space.tryAcquire(this->space.available());
+            if(t - this->head.loadAcquire() < quint32(this->capacity)){
+                break;
+            }
+            if(this->closed.loadAcquire()){
+                return false;
+            }
+            if(!waited){
+                this->blocked.fetchAndAddRelaxed(1);
+                waited = true;
+            }
+            this->space.tryAcquire(1, FRAME_QUEUE_BLOCK_POLL_MS);
+        }
+    }else{
+        forever{
+            quint32 h = this->head.loadAcquire();
+            if(t - h < quint32(this->capacity)){
+                break;
+            }
+            // full, take the oldest back unless the consumer takes it first
+            FFTFrame* oldest = this->slots[h & this->mask].loadAcquire();
+            if(this->head.testAndSetOrdered(h, h + 1)){
+                FFTFrameRef drop(oldest);
+                this->dropped.fetchAndAddRelaxed(1);
+            }
+        }
+    }
+
+    FFTFrameRef held(frame);    // the slot keeps this reference
+    this->slots[t & this->mask].storeRelease(held.frame);
+    held.frame = nullptr;
+    this->tail.storeRelease(t + 1);
+    this->pushed.fetchAndAddRelaxed(1);
+    if(this->notified.testAndSetOrdered(0, 1)){
+        this->sinceNotify = 0;
+        emit readyRead();
+    }else{
+        this->sinceNotify++;
+    }
+    return true;
+}
+
+/**
+ * @brief FrameQueue::pop take the oldest frame, consumer thread only
+ * @param frame set to the frame
+ * @return false if the queue is empty
+ */
+bool FrameQueue::pop(FFTFrameRef& frame){
+    forever{
+        quint32 h = this->head.loadAcquire();
+        if(h == this->tail.loadAcquire()){
+            return false;
+        }
+        // read the slot before claiming it, once head moves the producer may reuse it
+        FFTFrame* next = this->slots[h & this->mask].loadAcquire();
+        if(this->head.testAndSetOrdered(h, h + 1)){
+            frame = FFTFrameRef(next);
+            if(this->policy == FRAME_QUEUE_BLOCK){
+                this->space.release();
+            }
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief FrameQueue::close stop a blocked producer from waiting, later pushes fail once the queue is full
+ */
+void FrameQueue::close(){
+    this->closed.storeRelease(1);
+    this->space.release();
+}
+
+/**
+ * @brief frameQueuePolicyFromName parse a queue policy name
+ * @param name "latest", "drop-oldest" or "block", lower case
+ * @return a FrameQueuePolicy, or -1 if the name is unknown
+ */
+int frameQueuePolicyFromName(const char* name){
+    static const char* const names[] = { "latest", "drop-oldest", "block" };
+    for(int i = 0; i < 3; i++){
+        if(strcmp(name, names[i]) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,89 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QSemaphore>
+#include <cstring>
+#include "fftframe.h"
+
+#define FRAME_QUEUE_CAPACITY        16      // frames a consumer may fall behind before its policy kicks in
+#define FRAME_QUEUE_BLOCK_CAPACITY  256     // block queues are deeper so a short stall doesn't stall the radio
+#define FRAME_QUEUE_BLOCK_POLL_MS   100     // a blocked producer rechecks for close this often
+#define FRAME_QUEUE_STALL_FRAMES    16      // frames pushed without the consumer draining before it counts as stalled
+
+/**
+ * @brief The FrameQueuePolicy enum is what a FrameQueue does when its consumer falls behind
+ */
+enum FrameQueuePolicy {
+    FRAME_QUEUE_LATEST,         // only the newest frame is kept, for views that only show the latest
+    FRAME_QUEUE_DROP_OLDEST,    // the newest capacity frames are kept
+    FRAME_QUEUE_BLOCK           // the producer waits, nothing is dropped, upstream queues take up the stall
+};
+
+/**
+ * @brief The FrameQueue class hands FFT frames from the radio thread to one consumer
+ * It is a bounded ring of frame references, one producer and one consumer, no locks.
+ * The consumer is told about new frames by at most one queued readyRead event at a
+ * time, and drains every frame it has when that event runs, so a stalled consumer
+ * finds at most capacity frames waiting instead of a backlog of events.
+ * When the ring is full, drop-oldest has the producer take the oldest frame back;
+ * producer and consumer both claim frames by moving the read index with a CAS,
+ * so each frame is taken exactly once.
+ */
+class FrameQueue : public QObject
+{
+    Q_OBJECT
+public:
+    FrameQueue(FrameQueuePolicy policy, int capacity, QObject *parent = nullptr);
+    ~FrameQueue();
+    bool push(const FFTFrameRef& frame);
+    bool pop(FFTFrameRef& frame);
+    void close();
+    template<typename T> void deliverTo(T* receiver, void (T::*slot)(const FFTFrameRef&));
+    FrameQueuePolicy getPolicy() { return policy; }
+    int getCapacity() { return capacity; }
+    quint64 getPushed() { return pushed.loadAcquire(); }
+    quint64 getDropped() { return dropped.loadAcquire(); }
+    quint64 getBlocked() { return blocked.loadAcquire(); }
+    bool isStalled() { return notified.loadAcquire() != 0 && sinceNotify >= FRAME_QUEUE_STALL_FRAMES; }  // producer only
+
+signals:
+    void readyRead();
+
+private:
+    FrameQueuePolicy policy;
+    int capacity;                       // a power of two
+    quint32 mask;
+    QAtomicPointer<FFTFrame>* slots;    // each holds one reference while between head and tail
+    QAtomicInteger<quint32> head;       // next frame to read, moved by the consumer and by drops
+    QAtomicInteger<quint32> tail;       // next slot to write, only moved by the producer
+    QAtomicInt notified;                // a readyRead is on its way and hasn't started draining
+    int sinceNotify = 0;                // frames pushed since that readyRead, producer only
+    QAtomicInt closed;
+    QSemaphore space;                   // block policy, released for every frame read
+    QAtomicInteger<quint64> pushed;
+    QAtomicInteger<quint64> dropped;    // frames the consumer never saw
+    QAtomicInteger<quint64> blocked;    // pushes that had to wait for room
+};
+
+/**
+ * @brief FrameQueue::deliverTo drain the queue into a receiver's slot, in the receiver's thread
+ * @param receiver
+ * @param slot called once per frame, oldest first
+ */
+template<typename T>
+void FrameQueue::deliverTo(T* receiver, void (T::*slot)(const FFTFrameRef&)){
+    connect(this, &FrameQueue::readyRead, receiver, [this, receiver, slot](){
+        this->notified.storeRelease(0); // frames pushed from here on post another event
+        FFTFrameRef frame;
+        while(this->pop(frame)){
+            (receiver->*slot)(frame);
+        }
+    }, Qt::QueuedConnection);
+}
+
+int frameQueuePolicyFromName(const char* name);
+
+#endif // FRAMEQUEUE_H
@@ -1,5 +1,11 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QGestureEvent>
+#include <QPinchGesture>
+#include <QScreen>
+#include <QGuiApplication>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -38,14 +44,190 @@ MainWindow::MainWindow(QWidget *parent)
     connect(radio, &Radio::finished, radio, &QObject::deleteLater);
 
     // ==== waterfall object ====
-    // create a waterfall object
-    waterfall = new Waterfall(this, ui->waterfallLabel->width(), ui->waterfallLabel->height());
+    // create a waterfall object, drawing in the screen's pixel format unless WATERFALL_FORMAT says otherwise
+    QProcessEnvironment sys = QProcessEnvironment::systemEnvironment();
+    QImage::Format format = Waterfall::formatForDepth(QGuiApplication::primaryScreen()->depth());
+
+    // draw the waterfall straight into the framebuffer, a regular file can stand in
+    // for the device with its layout given by WATERFALL_FB_GEOMETRY, e.g. 800x480x16
+    if(sys.contains("WATERFALL_FRAMEBUFFER")){
+        int fbWidth = 0;
+        int fbHeight = 0;
+        int fbDepth = 0;
+        Framebuffer::parseGeometry(sys.value("WATERFALL_FB_GEOMETRY"), &fbWidth, &fbHeight, &fbDepth);
+        this->framebuffer = new Framebuffer();
+        if(this->framebuffer->open(sys.value("WATERFALL_FRAMEBUFFER"), fbWidth, fbHeight, fbDepth)){
+            // rows in the framebuffer's own format are copied without conversion
+            format = this->framebuffer->getFormat() == QImage::Format_RGB16 ? QImage::Format_RGB16 : QImage::Format_RGB32;
+        }else{
+            this->logMessage("could not map framebuffer " + sys.value("WATERFALL_FRAMEBUFFER"));
+            delete this->framebuffer;
+            this->framebuffer = nullptr;
+        }
+    }
+    QString formatName = sys.value("WATERFALL_FORMAT").toLower();
+    if(formatName == "rgb32"){
+        format = QImage::Format_RGB32;
+    }else if(formatName == "rgb565"){
+        format = QImage::Format_RGB16;
+    }else if(formatName == "indexed8"){
+        format = QImage::Format_Indexed8;
+    }
+    waterfall = new Waterfall(nullptr, ui->waterfallView->width(), ui->waterfallView->height(), format);
+    waterfall->setAutoLevel(true); // follow the signal level until a manual range is set
+
+    // built-in colormap, classic unless WATERFALL_COLORMAP names another one
+    if(sys.contains("WATERFALL_COLORMAP")){
+        int colormap = colormapFromName(sys.value("WATERFALL_COLORMAP").toLower().toLatin1().constData());
+        if(colormap >= 0){
+            waterfall->setColormap(colormap);
+        }
+    }
+
+    // scrollback memory cap
+    if(sys.contains("WATERFALL_HISTORY_BYTES")){
+        bool ok = false;
+        qint64 bytes = sys.value("WATERFALL_HISTORY_BYTES").toLongLong(&ok);
+        if(ok && bytes > 0){
+            waterfall->setHistoryBudget(bytes, HISTORY_DEFAULT_LEVELS);
+        }
+    }
+
+    // fixed time per row, frames arriving faster are merged
+    if(sys.contains("WATERFALL_ROW_MS")){
+        waterfall->setRowMerge(sys.value("WATERFALL_ROW_MERGE").toLower() == "mean" ? ROW_MERGE_MEAN : ROW_MERGE_MAX_HOLD);
+        waterfall->setRowPeriod(sys.value("WATERFALL_ROW_MS").toInt());
+    }
 
-    // connect waterfalls pixmapReady signal to main window's handleWaterfall slot
-    connect(waterfall, &Waterfall::pixmapReady, this, &MainWindow::handleWaterfall);
+    // drag on the waterfall to scroll back in time or pan in frequency, double tap to zoom out in time,
+    // pinch or mouse wheel to zoom in frequency
+    ui->waterfallView->installEventFilter(this);
+    ui->waterfallView->setAttribute(Qt::WA_AcceptTouchEvents);
+    ui->waterfallView->grabGesture(Qt::PinchGesture);
+
+    // the view paints straight from the waterfall, repaints capped at WATERFALL_FPS
+    ui->waterfallView->setWaterfall(waterfall);
+    ui->waterfallView->setFramebuffer(this->framebuffer);
+    if(sys.contains("WATERFALL_FPS")){
+        ui->waterfallView->setMaxFps(sys.value("WATERFALL_FPS").toInt());
+    }
+    ui->waterfallView->setChannels(&this->channelIndex);
+    connect(this, &MainWindow::changeTimeView, waterfall, &Waterfall::setTimeView);
+    connect(this, &MainWindow::playbackFrame, waterfall, &Waterfall::appendFFT);
+
+    // rows are tagged with the tuning they were captured on, a retune shifts the history instead of clearing it
+    waterfall->setCenterFreq(radio->getCenterFreq());
+    waterfall->setBandwidth(radio->getBandwidth());
+    connect(this, &MainWindow::changeFrequency, waterfall, &Waterfall::setCenterFreq);
+    connect(this, &MainWindow::retuned, waterfall, &Waterfall::setCenterFreq);
+    connect(this, &MainWindow::changeBandwidth, waterfall, &Waterfall::setBandwidth);
+    connect(this, &MainWindow::changeFrequencyView, waterfall, &Waterfall::setFrequencyView);
+
+    // render the waterfall in its own thread unless WATERFALL_THREAD=0, the GUI thread only blits
+    if(sys.value("WATERFALL_THREAD", "1") != "0"){
+        this->waterfallThread = new QThread(this);
+        waterfall->moveToThread(this->waterfallThread);
+        this->waterfallThread->start();
+    }
 
-    // connect radio's fftReady signal to waterfall's appendFFT slot
-    connect(radio, &Radio::fftReady, waterfall, &Waterfall::appendFFT);
+    // report how late the GUI event loop runs and how the waterfall view keeps up, to compare with and without the waterfall thread
+    if(sys.contains("GUI_LATENCY_MONITOR")){
+        this->latency = new EventLoopLatency(this);
+        connect(this->latency, &EventLoopLatency::report, this, &MainWindow::handleLatencyReport);
+        connect(ui->waterfallView, &WaterfallWidget::frameStats, this, &MainWindow::handleWaterfallStats);
+        this->latency->start();
+    }
+
+    // ==== spectrum object ====
+    // shares the waterfall's resampling tables when both run in this thread
+    spectrum = new Spectrum(this, ui->spectrumLabel->width(), ui->spectrumLabel->height(),
+                            this->waterfallThread == nullptr ? waterfall->getResampler() : nullptr);
+    if(sys.contains("SPECTRUM_FPS")){
+        spectrum->setMaxFps(sys.value("SPECTRUM_FPS").toInt());
+    }
+    // density of recent frames behind the trace, like the persistence mode of a bench analyzer
+    if(sys.value("SPECTRUM_PERSISTENCE", "0") != "0"){
+        spectrum->setPersistence(true);
+        if(sys.contains("SPECTRUM_PERSISTENCE_DECAY")){
+            spectrum->setPersistenceDecay(sys.value("SPECTRUM_PERSISTENCE_DECAY").toInt(), PERSISTENCE_DECAY_SHIFT);
+        }
+    }
+    connect(spectrum, &Spectrum::imageReady, this, &MainWindow::handleSpectrum);
+    connect(this, &MainWindow::changeFrequencyView, spectrum, &Spectrum::setFrequencyView);
+
+    // play back a spectrogram recording instead of showing live data
+    if(sys.contains("SPECTROGRAM_PLAYBACK")){
+        this->player = new SpectrogramPlayer(this);
+        if(this->player->open(sys.value("SPECTROGRAM_PLAYBACK"))){
+            // rows point into the mapped file, they have to be read before the next one
+            if(this->waterfallThread == nullptr){
+                connect(this->player, &SpectrogramPlayer::rowReady, waterfall, &Waterfall::appendRow, Qt::DirectConnection);
+            }else{
+                // the waterfall reads later in its own thread, hand it a copy
+                connect(this->player, &SpectrogramPlayer::rowReady, this, [this](const double* values, int bins){
+                    QVector<double> fft(bins);
+                    memcpy(fft.data(), values, bins*sizeof(double));
+                    emit playbackFrame(fft);
+                }, Qt::DirectConnection);
+            }
+            connect(this->player, &SpectrogramPlayer::rowReady, spectrum, &Spectrum::appendRow, Qt::DirectConnection);
+            this->player->play(this->player->getReader()->firstTimestamp());
+        }else{
+            this->logMessage("could not open spectrogram " + sys.value("SPECTROGRAM_PLAYBACK"));
+            delete this->player;
+            this->player = nullptr;
+        }
+    }
+
+    // radio's frames go to the waterfall and spectrum by handle, the payload is shared not copied.
+    // Each has its own bounded queue, a stalled consumer skips frames instead of replaying a backlog,
+    // WATERFALL_QUEUE and SPECTRUM_QUEUE pick the policy: latest, drop-oldest or block
+    if(this->player == nullptr){
+        this->waterfallQueue = this->createFrameQueue("WATERFALL_QUEUE", FRAME_QUEUE_DROP_OLDEST, FRAME_QUEUE_CAPACITY);
+        this->waterfallQueue->deliverTo(waterfall, &Waterfall::appendFrame);
+        this->spectrumQueue = this->createFrameQueue("SPECTRUM_QUEUE", FRAME_QUEUE_LATEST, 1);
+        this->spectrumQueue->deliverTo(spectrum, &Spectrum::appendFrame);
+    }
+
+    // record the spectrum, delta compressed unless SPECTROGRAM_RECORD_RAW is set
+    if(sys.contains("SPECTROGRAM_RECORD")){
+        this->recorder = new SpectrogramWriter(this);
+        SpectrogramEncoding encoding = sys.contains("SPECTROGRAM_RECORD_RAW") ? SPECTROGRAM_RAW_F64 : SPECTROGRAM_DELTA_VARINT;
+        if(this->recorder->open(sys.value("SPECTROGRAM_RECORD"), encoding)){
+            this->recorder->setCenterFreq(radio->getCenterFreq());
+            this->recorder->setBandwidth(radio->getBandwidth());
+            // a recording shouldn't have holes, so the radio waits for it unless SPECTROGRAM_RECORD_QUEUE says otherwise
+            this->recorderQueue = this->createFrameQueue("SPECTROGRAM_RECORD_QUEUE", FRAME_QUEUE_BLOCK, FRAME_QUEUE_BLOCK_CAPACITY);
+            this->recorderQueue->deliverTo(this->recorder, &SpectrogramWriter::appendFrame);
+            connect(this, &MainWindow::changeFrequency, this->recorder, &SpectrogramWriter::setCenterFreq);
+            connect(this, &MainWindow::retuned, this->recorder, &SpectrogramWriter::setCenterFreq);
+            connect(this, &MainWindow::changeBandwidth, this->recorder, &SpectrogramWriter::setBandwidth);
+        }else{
+            this->logMessage("could not create spectrogram " + sys.value("SPECTROGRAM_RECORD"));
+        }
+    }
+
+    // ask for self-describing FFT frames, RADIO_FFT_FORMAT is f64, f32, cdb16 or u8
+    if(sys.contains("RADIO_FFT_FORMAT")){
+        FFTWireType fftFormat;
+        if(fftWireFormatFromName(sys.value("RADIO_FFT_FORMAT").toLower().toLatin1().constData(), &fftFormat)){
+            radio->setFftFormat(fftFormat);
+        }else{
+            this->logMessage("unknown RADIO_FFT_FORMAT " + sys.value("RADIO_FFT_FORMAT"));
+        }
+    }
+    // and to compress them, worth it when the broker link is the bottleneck
+    if(sys.value("RADIO_FFT_COMPRESS", "0") != "0"){
+        radio->setFftCompression(true);
+    }
+
+    // flow control on radio_data: deliveries in flight, deliveries per ack and how long an ack may wait,
+    // RADIO_ACK_MS=0 acks at the end of every wakeup
+    if(sys.contains("RADIO_PREFETCH") || sys.contains("RADIO_ACK_BATCH") || sys.contains("RADIO_ACK_MS")){
+        radio->setAckPolicy(sys.value("RADIO_PREFETCH", QString::number(RADIO_PREFETCH)).toInt(),
+                            sys.value("RADIO_ACK_BATCH", QString::number(RADIO_ACK_BATCH)).toInt(),
+                            sys.value("RADIO_ACK_MS", QString::number(RADIO_ACK_MS)).toInt());
+    }
 
     radio->setupRadio(); // basic setup
     radio->start(); // start radio thread
@@ -85,8 +267,24 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // stop the producer before its consumers go, closing the queues lets a blocked push return
+    for(FrameQueue* queue : { this->waterfallQueue, this->spectrumQueue, this->recorderQueue }){
+        if(queue != nullptr){
+            queue->close();
+        }
+    }
+    radio->stop();
+    radio->wait();
+
+    ui->waterfallView->setFramebuffer(nullptr);
+    delete this->framebuffer;
     delete ui;
     delete radio;
+    delete spectrum;
+    if(this->waterfallThread != nullptr){
+        this->waterfallThread->quit();
+        this->waterfallThread->wait();
+    }
     delete waterfall;
 }
 
@@ -128,8 +326,7 @@ void MainWindow::initWidgets(){
     //      limit labels on waterfall display
     double center   = this->getCenterFreqSetpoint(); // wherever it happens to be
     double bw       = this->getBandwidthSetpoint();
-    ui->waterfallFreqLabelLeft->setText(QString("%1MHz").arg((center - bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelRight->setText(QString("%1MHz").arg((center + bw/2)/1.0e6, 0, 'f', 4));
+    this->updateWaterfallFreqLabels(center, bw);
 
 }
 
@@ -172,11 +369,152 @@ void MainWindow::handleMessage(const QString& msg){
 }
 
 /**
- * @brief MainWindow::handleWaterfall slot to handle new waterfall data
- * @param pixmap the waterfall pixmap
+ * @brief MainWindow::handleWaterfallStats slot for the waterfall view's repaint counters
+ * @param painted repaints so far
+ * @param coalesced frames merged into a later repaint
+ * @param dropped rows that scrolled off before being painted
+ */
+void MainWindow::handleWaterfallStats(quint64 painted, quint64 coalesced, quint64 dropped){
+    qDebug() << "waterfall repaints:" << painted << "coalesced frames:" << coalesced << "dropped rows:" << dropped;
+}
+
+/**
+ * @brief MainWindow::handleLatencyReport slot for the GUI event loop latency probe
+ * @param meanMs average lateness of the probe timer
+ * @param maxMs worst lateness of the probe timer
+ * @param samples probe events in the window
  */
-void MainWindow::handleWaterfall(const QPixmap& pixmap){
-    ui->waterfallLabel->setPixmap(pixmap);
+void MainWindow::handleLatencyReport(double meanMs, double maxMs, int samples){
+    qDebug() << "GUI event loop latency mean" << meanMs << "ms max" << maxMs << "ms over" << samples << "events,"
+             << (this->waterfallThread != nullptr ? "waterfall thread on" : "waterfall thread off");
+    if(this->waterfallQueue != nullptr){
+        qDebug() << "frames dropped: waterfall" << this->waterfallQueue->getDropped()
+                 << "spectrum" << this->spectrumQueue->getDropped()
+                 << "recorder" << (this->recorderQueue != nullptr ? this->recorderQueue->getDropped() : 0)
+                 << "radio waits for recorder" << (this->recorderQueue != nullptr ? this->recorderQueue->getBlocked() : 0);
+        qDebug() << "radio acks sent" << this->radio->getAcksSent() << "held for stalled consumers" << this->radio->getAckHolds();
+    }
+    qint64 produced = this->waterfall->getFrameTimestamp();
+    if(produced > 0){
+        // producer clock to screen, only meaningful if the clocks are in sync
+        qDebug() << "newest waterfall row is" << (QDateTime::currentMSecsSinceEpoch() - produced/1000) << "ms old";
+    }
+}
+
+/**
+ * @brief MainWindow::createFrameQueue make a queue for one consumer of the radio's FFT frames
+ * @param variable environment variable that may override the policy, "latest", "drop-oldest" or "block"
+ * @param policy used if the variable isn't set
+ * @param capacity frames the queue holds
+ * @return the queue, already added to the radio
+ */
+FrameQueue* MainWindow::createFrameQueue(const QString& variable, FrameQueuePolicy policy, int capacity){
+    QProcessEnvironment sys = QProcessEnvironment::systemEnvironment();
+    if(sys.contains(variable)){
+        int named = frameQueuePolicyFromName(sys.value(variable).toLower().toLatin1().constData());
+        if(named < 0){
+            this->logMessage("unknown " + variable + " " + sys.value(variable));
+        }else if(named != policy){
+            policy = FrameQueuePolicy(named);
+            capacity = policy == FRAME_QUEUE_BLOCK ? FRAME_QUEUE_BLOCK_CAPACITY : FRAME_QUEUE_CAPACITY;
+        }
+    }
+    FrameQueue* queue = new FrameQueue(policy, capacity, this);
+    this->radio->addFrameQueue(queue);
+    return queue;
+}
+
+/**
+ * @brief MainWindow::handleSpectrum slot to handle a new spectrum trace image
+ * @param image the spectrum image
+ */
+void MainWindow::handleSpectrum(const QImage& image){
+    ui->spectrumLabel->setPixmap(QPixmap::fromImage(image));
+}
+
+/**
+ * @brief MainWindow::eventFilter handles touch (synthesized mouse) input on the waterfall
+ * @param obj object the event was sent to
+ * @param event the event
+ * @return true if the event was consumed
+ * Dragging up pulls older rows into view, dragging back down to the top returns to live data.
+ * Dragging sideways pans a zoomed view across the band, a pinch or the mouse wheel zooms
+ * in frequency around the fingers or the cursor.
+ * A double tap zooms out in time by 2x, past the coarsest level it returns to live data
+ * and the whole band.
+ */
+bool MainWindow::eventFilter(QObject* obj, QEvent* event){
+    if(obj != ui->waterfallView || this->waterfall == nullptr){
+        return QMainWindow::eventFilter(obj, event);
+    }
+
+    switch(event->type()){
+    case QEvent::MouseButtonPress:{
+        QMouseEvent* mouse = static_cast<QMouseEvent*>(event);
+        this->waterfallDragStartX = mouse->pos().x();
+        this->waterfallDragStartY = mouse->pos().y();
+        this->waterfallDragStartOffset = this->waterfall->getTimeOffset();
+        this->waterfallDragStartView = this->freqViewStart;
+        this->waterfallDragAxis = 0;
+        return true;
+    }case QEvent::MouseMove:{
+        QMouseEvent* mouse = static_cast<QMouseEvent*>(event);
+        int dx = mouse->pos().x() - this->waterfallDragStartX;
+        int dy = this->waterfallDragStartY - mouse->pos().y(); // content follows the finger
+        if(this->waterfallDragAxis == 0){
+            if(abs(dx) < WATERFALL_DRAG_SLOP && abs(dy) < WATERFALL_DRAG_SLOP){
+                return true;
+            }
+            this->waterfallDragAxis = abs(dx) > abs(dy) ? Qt::Horizontal : Qt::Vertical;
+        }
+        if(this->waterfallDragAxis == Qt::Horizontal){
+            double width = ui->waterfallView->width() > 0 ? ui->waterfallView->width() : 1;
+            this->setFrequencyView(this->waterfallDragStartView - dx/width*this->freqViewSpan, this->freqViewSpan);
+        }else{
+            int level = this->waterfall->getTimeLevel();
+            emit changeTimeView(this->waterfallDragStartOffset + qint64(dy)*(qint64(1) << level), level);
+        }
+        return true;
+    }case QEvent::Wheel:{
+        QWheelEvent* wheel = static_cast<QWheelEvent*>(event);
+        double notches = wheel->angleDelta().y()/120.0;
+        double width = ui->waterfallView->width() > 0 ? ui->waterfallView->width() : 1;
+        this->zoomFrequencyView(this->freqViewSpan*pow(WATERFALL_WHEEL_ZOOM, -notches), wheel->position().x()/width);
+        return true;
+    }case QEvent::Gesture:{
+        QGestureEvent* gesture = static_cast<QGestureEvent*>(event);
+        QPinchGesture* pinch = static_cast<QPinchGesture*>(gesture->gesture(Qt::PinchGesture));
+        if(pinch == nullptr){
+            break;
+        }
+        if(pinch->state() == Qt::GestureStarted){
+            this->pinchStartView = this->freqViewStart;
+            this->pinchStartSpan = this->freqViewSpan;
+        }
+        if(pinch->totalScaleFactor() > 0.0){
+            // zoom around where the fingers were when the pinch started
+            double width = ui->waterfallView->width() > 0 ? ui->waterfallView->width() : 1;
+            double anchor = ui->waterfallView->mapFromGlobal(pinch->startCenterPoint().toPoint()).x()/width;
+            double span = this->pinchStartSpan/pinch->totalScaleFactor();
+            double freq = this->pinchStartView + anchor*this->pinchStartSpan;
+            this->setFrequencyView(freq - anchor*span, span);
+        }
+        gesture->accept(pinch);
+        return true;
+    }case QEvent::MouseButtonDblClick:{
+        int level = this->waterfall->getTimeLevel() + 1;
+        if(level >= this->waterfall->getTimeLevels()){
+            emit changeTimeView(0, 0); // back to live
+            this->setFrequencyView(0.0, 1.0);
+        }else{
+            emit changeTimeView(this->waterfall->getTimeOffset(), level);
+        }
+        return true;
+    }default:{
+        break;
+    }
+    }
+    return QMainWindow::eventFilter(obj, event);
 }
 
 /**
@@ -320,8 +658,86 @@ void MainWindow::logEvent(const QString &msg){
     this->log_ex->Publish(arr.data(), arr.size(), "");
 }
 
+/**
+ * @brief MainWindow::setFrequencyView zoom the waterfall and spectrum in on part of the band
+ * @param start left edge of the view as a fraction of the band
+ * @param span width of the view as a fraction of the band, clamped to 1/WATERFALL_MAX_ZOOM .. 1
+ */
+void MainWindow::setFrequencyView(double start, double span){
+    span = constrain(span, 1.0/WATERFALL_MAX_ZOOM, 1.0);
+    start = constrain(start, 0.0, 1.0 - span);
+    if(start == this->freqViewStart && span == this->freqViewSpan){
+        return;
+    }
+    this->freqViewStart = start;
+    this->freqViewSpan = span;
+    emit changeFrequencyView(start, span);
+    if(this->waterfallLabelBandwidth > 0.0){
+        this->updateWaterfallFreqLabels(this->waterfallLabelCenter, this->waterfallLabelBandwidth);
+    }
+}
+
+/**
+ * @brief MainWindow::zoomFrequencyView change the zoom keeping one point of the view still
+ * @param span new width of the view as a fraction of the band
+ * @param anchor point that stays put, as a fraction of the view's width
+ */
+void MainWindow::zoomFrequencyView(double span, double anchor){
+    span = constrain(span, 1.0/WATERFALL_MAX_ZOOM, 1.0);
+    double freq = this->freqViewStart + anchor*this->freqViewSpan;
+    this->setFrequencyView(freq - anchor*span, span);
+}
+
+/**
+ * @brief MainWindow::updateWaterfallFreqLabels show the edges and center of the waterfall
+ * @param center center frequency in Hz
+ * @param bw bandwidth in Hz
+ * called on every status update, labels are only touched when their text changes
+ * when zoomed in the labels show the visible part of the band
+ */
+void MainWindow::updateWaterfallFreqLabels(double center, double bw){
+    if(center == this->waterfallLabelCenter && bw == this->waterfallLabelBandwidth &&
+       this->freqViewStart == this->waterfallLabelViewStart && this->freqViewSpan == this->waterfallLabelViewSpan){
+        return;
+    }
+    this->waterfallLabelCenter = center;
+    this->waterfallLabelBandwidth = bw;
+    this->waterfallLabelViewStart = this->freqViewStart;
+    this->waterfallLabelViewSpan = this->freqViewSpan;
+    center += (this->freqViewStart + this->freqViewSpan/2 - 0.5)*bw;
+    bw *= this->freqViewSpan;
+    ui->waterfallView->setFrequencyWindow(center, bw);
+
+    QString left   = QString("%1MHz").arg((center - bw/2)/1.0e6, 0, 'f', 4);
+    QString right  = QString("%1MHz").arg((center + bw/2)/1.0e6, 0, 'f', 4);
+    QString middle = QString("%1MHz").arg(center/1.0e6, 0, 'f', 4);
+    if(ui->waterfallFreqLabelLeft->text() != left){
+        ui->waterfallFreqLabelLeft->setText(left);
+    }
+    if(ui->waterfallFreqLabelRight->text() != right){
+        ui->waterfallFreqLabelRight->setText(right);
+    }
+    if(ui->waterfallFreqLabelCenter->text() != middle){
+        ui->waterfallFreqLabelCenter->setText(middle);
+    }
+}
+
+/**
+ * @brief MainWindow::updateChannelMarkers rebuild the channels marked on the waterfall
+ * from the selected county and the active scan list, called whenever either changes
+ */
+void MainWindow::updateChannelMarkers(){
+    if(this->selected_county != nullptr){
+        this->channelIndex.build(this->selected_county->channels, this->scanChannels);
+    }else{
+        this->channelIndex.build(QVector<Channel>(), this->scanChannels);
+    }
+    ui->waterfallView->channelsChanged();
+}
+
 /**
  * @brief MainWindow::setCenterFreqSetpoint programmatically set the center freq. slider to given freq.
+ * The slider doesn't emit actionTriggered for this, so the waterfall and recorder are told through retuned
  * @param freq frequency to set the slider to
  */
 void MainWindow::setCenterFreqSetpoint(double freq){
@@ -331,11 +747,10 @@ void MainWindow::setCenterFreqSetpoint(double freq){
                                double(ui->frequencySlider->minimum()),
                                double(ui->frequencySlider->maximum())) );
     ui->frequencySlider->setValue(slider_value);
+    emit retuned(freq); // not changeFrequency, the radio already has it from its status or the keypad
 
     double bw = this->getBandwidthSetpoint();
-    ui->waterfallFreqLabelLeft->setText(QString("%1MHz").arg((freq - bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelRight->setText(QString("%1MHz").arg((freq + bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelCenter->setText(QString("%1MHz").arg(freq/1.0e6, 0, 'f', 4));
+    this->updateWaterfallFreqLabels(freq, bw);
 }
 
 /**
@@ -351,9 +766,7 @@ void MainWindow::setBandwidthSetpoint(double bw){
     ui->bandwidthLcdNumber->display(QString("%1").arg(bw/1.0e3, 0, 'f', 1));
 
     double freq = this->getCenterFreqSetpoint();
-    ui->waterfallFreqLabelLeft->setText(QString("%1MHz").arg((freq - bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelRight->setText(QString("%1MHz").arg((freq + bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelCenter->setText(QString("%1MHz").arg(freq/1.0e6, 0, 'f', 4));
+    this->updateWaterfallFreqLabels(freq, bw);
 }
 
 void MainWindow::on_frequencySlider_actionTriggered(int action)
@@ -366,9 +779,7 @@ void MainWindow::on_frequencySlider_actionTriggered(int action)
 //    ui->activeFrequency->display(longs);
 
     double bw = this->getBandwidthSetpoint();
-    ui->waterfallFreqLabelLeft->setText(QString("%1MHz").arg((center - bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelRight->setText(QString("%1MHz").arg((center + bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelCenter->setText(QString("%1MHz").arg(center/1.0e6, 0, 'f', 4));
+    this->updateWaterfallFreqLabels(center, bw);
 
 }
 
@@ -381,9 +792,7 @@ void MainWindow::on_bandwidthSlider_actionTriggered(int action)
     ui->bandwidthLcdNumber->display(s);
 
     double center = this->getCenterFreqSetpoint();
-    ui->waterfallFreqLabelLeft->setText(QString("%1MHz").arg((center - bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelRight->setText(QString("%1MHz").arg((center + bw/2)/1.0e6, 0, 'f', 4));
-    ui->waterfallFreqLabelCenter->setText(QString("%1MHz").arg(center/1.0e6, 0, 'f', 4));
+    this->updateWaterfallFreqLabels(center, bw);
 }
 
 void MainWindow::on_frequencySlider_sliderPressed()
@@ -703,6 +1112,8 @@ void MainWindow::on_beginScanBtn_clicked()
         // click should signal stop
         emit changeSearch(false); // signal the stop of scanning
         ui->currentChannelInfoLbl->setText("----");
+        this->scanChannels.clear();
+        this->updateChannelMarkers();
         ui->beginScanBtn->setText("Begin Scan");
     }else{
         // send the list of channels listed in scanListListView to the backend
@@ -717,6 +1128,8 @@ void MainWindow::on_beginScanBtn_clicked()
         }
         emit setChannelScanList(channels); // set the scan list
         emit changeSearch(true); // trigger the start of scanning
+        this->scanChannels = channels;
+        this->updateChannelMarkers();
 
         ui->beginScanBtn->setText("Stop Scan");
     }
@@ -841,6 +1254,7 @@ void MainWindow::scrapeChannelsHandleStdout(int exitCode, QProcess::ExitStatus e
         // no need to update from the actual file, we already have the info in a vector
         logMessage(QString("calling updateChannels for %1 county...").arg(selected_county->name));
         this->radio->updateChannels(selected_state->name, selected_county->name, combinedChannels);
+        this->updateChannelMarkers();
     }
 
     // finally write out to corresponding file
@@ -1022,6 +1436,7 @@ void MainWindow::on_setupStateNextButton_clicked()
         if(this->selected_county == nullptr || this->selected_county->name.compare(str) != 0){
             // new county selected
             this->selected_county = this->selected_state->getCountyByName(str);
+            this->updateChannelMarkers();
         }
         switchSetupState(MainWindow::SELECT_PROTOCOL);
         break;
@@ -1033,6 +1448,7 @@ void MainWindow::on_setupStateNextButton_clicked()
         // need to do this regardless of whether additional scraping is necessary
         // gets current p25 systems for example, additional ones might come in shortly
         this->radio->updateChannelsFromFile(selected_state->name, selected_county->name);
+        this->updateChannelMarkers();
 
         if(str.compare("p25", Qt::CaseInsensitive) == 0){
             // need to web scrape systems at this point
@@ -1133,8 +1549,10 @@ void MainWindow::on_setupListView_clicked(const QModelIndex &index)
         break;
     }case MainWindow::SELECT_COUNTY:{
         ui->setupStateNextButton->setDisabled(false);
-        if(this->selected_state != nullptr)
+        if(this->selected_state != nullptr){
             this->selected_county = this->selected_state->getCountyByName(str);
+            this->updateChannelMarkers();
+        }
 
         break;
     }case MainWindow::SELECT_PROTOCOL:{
@@ -1187,3 +1605,28 @@ void MainWindow::on_clearScanListBtn_clicked()
     ui->scanListListView->setModel(model);
     ui->beginScanBtn->setDisabled(true);
 }
+
+void MainWindow::on_traceLiveBtn_clicked()
+{
+    this->spectrum->setMode(TRACE_LIVE);
+}
+
+void MainWindow::on_traceAverageBtn_clicked()
+{
+    this->spectrum->setMode(TRACE_AVERAGE);
+}
+
+void MainWindow::on_traceMeanBtn_clicked()
+{
+    this->spectrum->setMode(TRACE_MEAN);
+}
+
+void MainWindow::on_traceMaxHoldBtn_clicked()
+{
+    this->spectrum->setMode(TRACE_MAX_HOLD);
+}
+
+void MainWindow::on_traceMinHoldBtn_clicked()
+{
+    this->spectrum->setMode(TRACE_MIN_HOLD);
+}
@@ -6,8 +6,17 @@
 #include <QDir>
 #include "radio.h"
 #include "waterfall.h"
+#include "waterfallwidget.h"
+#include "eventlooplatency.h"
+#include "framequeue.h"
+#include "spectrum.h"
+#include "spectrogramfile.h"
+#include "channelindex.h"
 #include "AMQPcpp.h"
 
+#define WATERFALL_DRAG_SLOP     8       // pixels moved before a drag is locked to time or frequency
+#define WATERFALL_WHEEL_ZOOM    1.25    // frequency zoom per mouse wheel notch
+
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
@@ -31,10 +40,17 @@ public:
     };
     qint64 startMSecs = 0;
 
+protected:
+    bool eventFilter(QObject* obj, QEvent* event) override;
+
 public slots:
     void handleMessage(const QString &);
 
-    void handleWaterfall(const QPixmap &);
+    void handleWaterfallStats(quint64 painted, quint64 coalesced, quint64 dropped);
+
+    void handleLatencyReport(double meanMs, double maxMs, int samples);
+
+    void handleSpectrum(const QImage &);
 
     void handleStatusUpdate(const RadioStatus &);
 
@@ -143,10 +159,29 @@ private slots:
 
     void on_clearScanListBtn_clicked();
 
+    void on_traceLiveBtn_clicked();
+
+    void on_traceAverageBtn_clicked();
+
+    void on_traceMeanBtn_clicked();
+
+    void on_traceMaxHoldBtn_clicked();
+
+    void on_traceMinHoldBtn_clicked();
+
 private:
     Ui::MainWindow *ui;
     Radio* radio = nullptr;
     Waterfall* waterfall = nullptr;
+    QThread* waterfallThread = nullptr;
+    Framebuffer* framebuffer = nullptr;
+    EventLoopLatency* latency = nullptr;
+    Spectrum* spectrum = nullptr;
+    SpectrogramWriter* recorder = nullptr;
+    SpectrogramPlayer* player = nullptr;
+    FrameQueue* waterfallQueue = nullptr;
+    FrameQueue* spectrumQueue = nullptr;
+    FrameQueue* recorderQueue = nullptr;
     QStringList keypadEntry;
     RadioStatus* radioStatus = nullptr;
     AMQP* amqp = nullptr;
@@ -164,14 +199,35 @@ private:
     QString sortBy = "";
     QString sortValue = "";
     bool areWeScanning = false;
+    int waterfallDragStartX = 0;
+    int waterfallDragStartY = 0;
+    qint64 waterfallDragStartOffset = 0;
+    double waterfallDragStartView = 0.0;
+    int waterfallDragAxis = 0;              // 0 until the drag moves, then Qt::Vertical scrolls time, Qt::Horizontal pans frequency
+    double freqViewStart = 0.0;             // zoomed part of the band, as fractions of it
+    double freqViewSpan = 1.0;
+    double pinchStartView = 0.0;
+    double pinchStartSpan = 1.0;
+    double waterfallLabelCenter = -1.0;     // frequencies the waterfall labels currently show
+    double waterfallLabelBandwidth = -1.0;
+    double waterfallLabelViewStart = -1.0;
+    double waterfallLabelViewSpan = -1.0;
+    ChannelIndex channelIndex;          // channels marked on the waterfall
+    QVector<Channel> scanChannels;      // the active scan list, empty when not scanning
     void initWidgets();
     double getBandwidthSetpoint();
     double getCenterFreqSetpoint();
     double getFreqFineAdjustOffset();
+    void updateWaterfallFreqLabels(double center, double bw);
+    void updateChannelMarkers();
+    void setFrequencyView(double start, double span);
+    FrameQueue* createFrameQueue(const QString& variable, FrameQueuePolicy policy, int capacity);
+    void zoomFrequencyView(double span, double anchor);
 
 signals:
     void changeFrequency(double freq);
     void changeListenFreq(double freq);
+    void retuned(double freq);
     void changeBandwidth(double bw);
     void changeVolume(double vol);
     void changeSquelch(double squelch);
@@ -181,6 +237,9 @@ signals:
     void changeScanStep(double freq);
     void changeProtocol(QString str);
     void setChannelScanList(QVector<Channel> channels);
+    void changeTimeView(qint64 offset, int level);
+    void changeFrequencyView(double start, double span);
+    void playbackFrame(const QVector<double>& fft);
 
 };
 #endif // MAINWINDOW_H
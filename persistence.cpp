@@ -0,0 +1,167 @@
+#include "persistence.h"
+
+/**
+ * @brief Persistence::Persistence constructor
+ * @param width pixel columns, one value per column is added each frame
+ * @param height power levels, the rows of the image
+ */
+Persistence::Persistence(int width, int height){
+    this->width = width;
+    this->height = height;
+    this->grid = (uint16_t*)malloc(this->width*this->height*sizeof(uint16_t));
+    this->spare = (uint16_t*)malloc(this->width*this->height*sizeof(uint16_t));
+    this->lut = colormap32(COLORMAP_INFERNO);
+    this->clear();
+}
+
+Persistence::~Persistence(){
+    free(this->grid);
+    free(this->spare);
+}
+
+/**
+ * @brief Persistence::clear forget all hits
+ */
+void Persistence::clear(){
+    memset(this->grid, 0, this->width*this->height*sizeof(uint16_t));
+    this->frames = 0;
+}
+
+/**
+ * @brief Persistence::setDecay set how fast old hits fade
+ * @param frames frames between decay passes
+ * @param shift each pass takes 1/2^shift off every cell, 1 to 15
+ * a lone hit lasts about frames*2^shift frames
+ */
+void Persistence::setDecay(int frames, int shift){
+    this->decayFrames = frames > 0 ? frames : 1;
+    this->decayShift = shift < 1 ? 1 : (shift > 15 ? 15 : shift);
+}
+
+/**
+ * @brief Persistence::setRange change the power range of the rows, the hits so far are moved to match
+ * @param min power in dB at the bottom row
+ * @param max power in dB at the top row
+ */
+void Persistence::setRange(double min, double max){
+    if(min == this->min && max == this->max){
+        return;
+    }
+    if(max > min && this->max > this->min && this->height > 1){
+        double step = (max - min)/(this->height - 1);
+        double oldStep = (this->max - this->min)/(this->height - 1);
+        if(step <= oldStep){
+            // rows got finer, each new row copies the old row it falls in
+            for(int y = 0; y < this->height; y++){
+                long from = lrint((this->max - (max - y*step))/oldStep);
+                uint16_t* line = this->spare + y*this->width;
+                if(from >= 0 && from < this->height){
+                    memcpy(line, this->grid + from*this->width, this->width*sizeof(uint16_t));
+                }else{
+                    memset(line, 0, this->width*sizeof(uint16_t));
+                }
+            }
+        }else{
+            // rows got coarser, old rows are summed into the new row they fall in so no hit is lost
+            memset(this->spare, 0, this->width*this->height*sizeof(uint16_t));
+            for(int y = 0; y < this->height; y++){
+                long to = lrint((max - (this->max - y*oldStep))/step);
+                if(to < 0 || to >= this->height){
+                    continue;
+                }
+                const uint16_t* from = this->grid + y*this->width;
+                uint16_t* line = this->spare + to*this->width;
+                for(int x = 0; x < this->width; x++){
+                    uint32_t sum = uint32_t(line[x]) + from[x];
+                    line[x] = sum < 0xFFFF ? uint16_t(sum) : uint16_t(0xFFFF);
+                }
+            }
+        }
+        uint16_t* swap = this->grid;
+        this->grid = this->spare;
+        this->spare = swap;
+    }
+    this->min = min;
+    this->max = max;
+}
+
+/**
+ * @brief Persistence::addFrame count one frame, one hit per column
+ * @param columns width values in dB, NaN columns and values outside the range are skipped
+ * clamping them would pile everything off scale onto the top and bottom rows
+ */
+void Persistence::addFrame(const double* columns){
+    double span = this->max > this->min ? this->max - this->min : 1.0;
+    double scale = (this->height - 1)/span;
+    for(int x = 0; x < this->width; x++){
+        double v = columns[x];
+        if(!(v >= this->min && v <= this->max)){
+            continue;   // also NaN
+        }
+        int row = int((this->max - v)*scale + 0.5);
+        row = row < this->height ? row : this->height - 1;
+        uint16_t& cell = this->grid[row*this->width + x];
+        cell = cell < 0xFFFF - PERSISTENCE_HIT ? uint16_t(cell + PERSISTENCE_HIT) : uint16_t(0xFFFF);
+    }
+
+    if(++this->frames >= this->decayFrames){
+        this->frames = 0;
+        this->decay();
+    }
+}
+
+/**
+ * @brief Persistence::decay take 1/2^decayShift, and at least 1, off every cell
+ * the subtraction saturates so empty cells stay empty
+ */
+void Persistence::decay(){
+    uint16_t* cells = this->grid;
+    int n = this->width*this->height;
+    int shift = this->decayShift;
+    int i = 0;
+
+#if defined(COLORIZE_AVX2)
+    const __m128i vshift = _mm_cvtsi32_si128(shift);
+    const __m256i vone   = _mm256_set1_epi16(1);
+    for(; i + 16 <= n; i += 16){
+        __m256i c = _mm256_loadu_si256((const __m256i*)(cells + i));
+        c = _mm256_subs_epu16(_mm256_sub_epi16(c, _mm256_srl_epi16(c, vshift)), vone);
+        _mm256_storeu_si256((__m256i*)(cells + i), c);
+    }
+#elif defined(COLORIZE_SSE2)
+    const __m128i vshift = _mm_cvtsi32_si128(shift);
+    const __m128i vone   = _mm_set1_epi16(1);
+    for(; i + 8 <= n; i += 8){
+        __m128i c = _mm_loadu_si128((const __m128i*)(cells + i));
+        c = _mm_subs_epu16(_mm_sub_epi16(c, _mm_srl_epi16(c, vshift)), vone);
+        _mm_storeu_si128((__m128i*)(cells + i), c);
+    }
+#elif defined(COLORIZE_NEON)
+    const int16x8_t  vshift = vdupq_n_s16(int16_t(-shift));
+    const uint16x8_t vone   = vdupq_n_u16(1);
+    for(; i + 8 <= n; i += 8){
+        uint16x8_t c = vld1q_u16(cells + i);
+        c = vqsubq_u16(vsubq_u16(c, vshlq_u16(c, vshift)), vone);
+        vst1q_u16(cells + i, c);
+    }
+#endif
+
+    for(; i < n; i++){
+        uint16_t c = uint16_t(cells[i] - (cells[i] >> shift));
+        cells[i] = c > 0 ? uint16_t(c - 1) : 0;
+    }
+}
+
+/**
+ * @brief Persistence::render colorize the grid, cells never hit are black
+ * @param target width x height image, Format_RGB32
+ */
+void Persistence::render(QImage& target){
+    for(int y = 0; y < this->height; y++){
+        const uint16_t* line = this->grid + y*this->width;
+        uint32_t* out = (uint32_t*)target.scanLine(y);
+        for(int x = 0; x < this->width; x++){
+            out[x] = line[x] == 0 ? 0xFF000000 : this->lut[line[x] >> 8];
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <QImage>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "colorize.h"
+#include "colormaps.h"
+
+#define PERSISTENCE_HIT             1024    // added to a cell per hit, 64 hits in a row saturate it
+#define PERSISTENCE_DECAY_FRAMES    4       // frames between decay passes
+#define PERSISTENCE_DECAY_SHIFT     4       // each decay pass takes 1/16 off every cell
+
+/**
+ * @brief The Persistence class counts how often each power level was hit in each pixel column
+ * It is a fixed width x height grid of 16 bit counts, row 0 at the top of the range.
+ * A frame costs one saturating add per column. Old hits fade by a decay pass over the
+ * whole grid every few frames, vectorized like the colorize functions, rather than
+ * by touching every cell on every frame.
+ */
+class Persistence
+{
+public:
+    Persistence(int width, int height);
+    ~Persistence();
+    void clear();
+    void setDecay(int frames, int shift);
+    void setRange(double min, double max);
+    void setColormap(int colormap) { lut = colormap32(colormap); }
+    void addFrame(const double* columns);
+    void render(QImage& target);
+    int getWidth() { return width; }
+    int getHeight() { return height; }
+
+private:
+    void decay();
+    int width;
+    int height;
+    double min = -50.0;         // power in dB at the bottom row
+    double max = 50.0;          // power in dB at the top row
+    int decayFrames = PERSISTENCE_DECAY_FRAMES;
+    int decayShift = PERSISTENCE_DECAY_SHIFT;
+    int frames = 0;             // frames since the last decay pass
+    uint16_t* grid;             // height rows of width counts
+    uint16_t* spare;            // same size as grid, used when the range changes
+    const uint32_t* lut;
+};
+
+#endif // PERSISTENCE_H
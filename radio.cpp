@@ -52,6 +52,8 @@ RadioConfig::RadioConfig(const RadioConfig& conf){
     this->beginSearch       = conf.beginSearch;
     this->update            = conf.update;
     this->protocolStr       = conf.protocolStr;
+    this->fftFormat         = conf.fftFormat;
+    this->fftEncoding       = conf.fftEncoding;
 }
 
 /**
@@ -428,13 +430,72 @@ Radio::Radio(QObject *parent) :
     radioStatus(new RadioStatus()),
     radioProcess(new QProcess(parent)),
     amqp(new AMQP("localhost")),
-    configMtx(new QMutex())
+    configMtx(new QMutex()),
+    framePool(new FFTFramePool())
 {
-
+    if(pipe(this->wakePipe) == 0){
+        fcntl(this->wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(this->wakePipe[1], F_SETFL, O_NONBLOCK);
+    }else{
+        this->wakePipe[0] = this->wakePipe[1] = -1;
+    }
 }
 
 Radio::~Radio(){
     this->radioProcess->kill();
+    this->pending.reset();
+    this->framePool->close();  // frames still queued to receivers are freed as they come back
+    if(this->wakePipe[0] >= 0){
+        close(this->wakePipe[0]);
+        close(this->wakePipe[1]);
+    }
+}
+
+/**
+ * @brief Radio::stop ask the radio thread to leave its main loop, wait() for it to finish
+ * unacked deliveries go back to the broker when the connection closes.
+ * Close the frame queues first, a push blocked on a stalled consumer only gives up once its queue is closed
+ */
+void Radio::stop(){
+    this->requestInterruption();
+    this->wake();
+}
+
+/**
+ * @brief Radio::addFrameQueue hand every FFT frame to a consumer through a bounded queue, call before start()
+ * @param queue not owned, has to outlive the radio thread
+ */
+void Radio::addFrameQueue(FrameQueue* queue){
+    this->frameQueues.append(queue);
+}
+
+/**
+ * @brief Radio::setAckPolicy set how deliveries are acknowledged, call before start()
+ * Acks go out once batch deliveries are unacknowledged or the oldest has waited intervalMs,
+ * but not while a consumer is stalled. The broker then stops at prefetch unacknowledged
+ * deliveries and holds the rest, so a stalled GUI slows the stream instead of the radio
+ * thread decoding frames nobody will see.
+ * @param prefetch deliveries in flight at most, at least 1
+ * @param batch deliveries per ack, at most half of prefetch so the broker never waits on a full window
+ * @param intervalMs longest an ack is held while the consumers keep up
+ */
+void Radio::setAckPolicy(int prefetch, int batch, int intervalMs){
+    this->prefetch = qBound(1, prefetch, 65535);
+    this->ackBatch = qBound(1, batch, qMax(1, this->prefetch/2));
+    this->ackIntervalMs = qMax(0, intervalMs);
+}
+
+/**
+ * @brief Radio::consumersStalled
+ * @return true if a consumer hasn't drained its queue for FRAME_QUEUE_STALL_FRAMES frames
+ */
+bool Radio::consumersStalled(){
+    for(FrameQueue* queue : this->frameQueues){
+        if(queue->isStalled()){
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
@@ -827,14 +888,14 @@ void Radio::setCenterFreq(double freq){
     this->configMtx->lock();
     this->radioConfig->centerFrequency = freq;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("centerFrequency", QJsonValue(freq)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 void Radio::setListenFreq(double freq){
     this->configMtx->lock();
     this->radioConfig->listenFrequency = freq;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("centerFrequency", QJsonValue(freq)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 /**
@@ -845,7 +906,7 @@ void Radio::setFftPoints(int points){
     this->configMtx->lock();
     this->radioConfig->fftPoints = points;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("fftPoints", QJsonValue(points)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 /**
@@ -856,7 +917,7 @@ void Radio::setBandwidth(double bw){
     this->configMtx->lock();
     this->radioConfig->bandwidth = bw;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("bandwidth", QJsonValue(bw)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 /**
@@ -872,32 +933,32 @@ void Radio::setVolume(double volume){
     this->configMtx->lock();
     this->radioConfig->volume = volume;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("volume", QJsonValue(volume)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 void Radio::setStartFreq(double freq){
     this->configMtx->lock();
     this->radioConfig->scanStartFreq = freq;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("scanStart", QJsonValue(freq)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 void Radio::setStopFreq(double freq){
     this->configMtx->lock();
     this->radioConfig->scanStopFreq = freq;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("scanStop", QJsonValue(freq)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 void Radio::setStepSize(double freq){
     this->configMtx->lock();
     this->radioConfig->stepSize = freq;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("fftStep", QJsonValue(freq)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 void Radio::setScanStep(double freq){
     this->configMtx->lock();
     this->radioConfig->scanStep = freq;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("scanStep", QJsonValue(freq)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 void Radio::setSquelch(double squelch){
     if(squelch > 1.0){
@@ -908,13 +969,13 @@ void Radio::setSquelch(double squelch){
     this->configMtx->lock();
     this->radioConfig->squelch = squelch;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("squelch", QJsonValue(squelch)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 void Radio::setSearch(bool search){
     this->configMtx->lock();
     this->radioConfig->beginSearch = search;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("beginSearch", QJsonValue(search)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 /**
  * @brief Radio::configureRadio slot for updating radioConfig
@@ -924,7 +985,7 @@ void Radio::configureRadio(const RadioConfig& config){
     this->configMtx->lock();
     this->radioConfig = new RadioConfig(config);
     this->radioConfig->update = true;
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 /**
@@ -959,7 +1020,29 @@ void Radio::setProtocol(const QString& str){
     this->configMtx->lock();
     this->radioConfig->protocolStr = str;
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("protocol", QJsonValue(this->radioConfig->protocolStr)));
-    this->configMtx->unlock();
+    this->releaseConfig();
+}
+
+/**
+ * @brief Radio::setFftFormat ask the radio process to send FFT frames as application/x-sdr-fft
+ * @param type sample type of the bins, frames already in flight keep the old format and still decode
+ */
+void Radio::setFftFormat(FFTWireType type){
+    this->configMtx->lock();
+    this->radioConfig->fftFormat = QString("%1; sample=%2").arg(FFT_WIRE_CONTENT_TYPE).arg(fftWireTypeName(type));
+    this->radioConfig->packets.append(QPair<QString, QJsonValue>("fftFormat", QJsonValue(this->radioConfig->fftFormat)));
+    this->releaseConfig();
+}
+
+/**
+ * @brief Radio::setFftCompression ask the radio process to compress application/x-sdr-fft frames or not
+ * @param compress true for x-sdr-delta-zlib, costs CPU on both ends for less bandwidth
+ */
+void Radio::setFftCompression(bool compress){
+    this->configMtx->lock();
+    this->radioConfig->fftEncoding = compress ? FFT_WIRE_ENCODING : "identity";
+    this->radioConfig->packets.append(QPair<QString, QJsonValue>("fftEncoding", QJsonValue(this->radioConfig->fftEncoding)));
+    this->releaseConfig();
 }
 
 /**
@@ -1010,7 +1093,7 @@ void Radio::addChannelsToScanList(QVector<Channel> channels){
 
     this->configMtx->lock();
     this->radioConfig->packets.append(QPair<QString, QJsonValue>("channels", QJsonValue(chArr)));
-    this->configMtx->unlock();
+    this->releaseConfig();
 }
 
 /**
@@ -1061,18 +1144,32 @@ void Radio::readRadioProcessStdout(){
 }
 
 /**
- * @brief Radio::populateFFT populate this object's fft vector from char array containing doubles
- * @param data raw data
- * @param size number of bytes in data
+ * @brief Radio::allocateBody pick where a delivery's body is assembled, called once its headers are in
+ * @param m the delivery, headers only
+ * @param size body size in bytes
+ * @return storage in a pooled frame for FFT payloads, nullptr keeps other bodies in the message
  */
-void Radio::populateFFT(char* data, int size){
-    int doubles = size/sizeof(double);
-    this->fft.resize(doubles);
-    double value;
-    for(int i = 0; i < size; i+=sizeof(double)){
-        memcpy(&value, data + i, sizeof(double));
-        this->fft[i/sizeof(double)] = value;
+char* Radio::allocateBody(AMQPMessage* m, size_t size){
+    this->pending.reset(); // left over if the last body failed half way
+    const std::string* contentType = m->findHeader("Content-type");
+    if(contentType == nullptr){
+        return nullptr;
     }
+    // self-describing frames, the header says what the bins are once the body is in
+    this->pendingWire = isFFTWireContentType(contentType->c_str());
+    if(this->pendingWire){
+        const std::string* encoding = m->findHeader("Content-encoding");
+        this->pendingEncoded = encoding != nullptr && *encoding == FFT_WIRE_ENCODING;
+        this->pending = this->framePool->acquire(SAMPLE_DOUBLE, size);
+        return this->pending.isNull() ? nullptr : this->pending->data();
+    }
+    // "application/octet-stream; sample=f32" etc, bare octet-stream is doubles
+    SampleType sampleType = SAMPLE_DOUBLE;
+    if(!sampleTypeFromContentType(contentType->c_str(), &sampleType)){
+        return nullptr;
+    }
+    this->pending = this->framePool->acquire(sampleType, size);
+    return this->pending.isNull() ? nullptr : this->pending->data();
 }
 
 /**
@@ -1081,60 +1178,266 @@ void Radio::populateFFT(char* data, int size){
  * if radioConfig has been updated, it sends out config data on txqu
  */
 void Radio::run(){
-    forever{
+    bool consuming = this->startConsuming();
+    struct timeval noWait = { 0, 0 };
+    uint32_t lastTag = 0;       // newest delivery not acked yet
+    int unacked = 0;
+    QElapsedTimer oldest;       // since the oldest unacked delivery arrived
+    bool holding = false;
+    while(!this->isInterruptionRequested()){
+        if(!consuming){
+            // nothing arrives on the socket until the broker has a consumer, try again shortly, stop() still wakes us
+            struct pollfd wake;
+            wake.fd = this->wakePipe[0];
+            wake.events = POLLIN;
+            wake.revents = 0;
+            if(poll(&wake, 1, RADIO_CONSUME_RETRY_MS) > 0 && (wake.revents & POLLIN)){
+                char buf[64];
+                while(read(this->wakePipe[0], buf, sizeof(buf)) > 0){
+                }
+            }
+            try{
+                this->publishConfig();  // the exchange may still take config while the queue is refused
+            }catch(AMQPException e){
+                emit debugMessage(QString(e.getMessage().c_str()));
+                qDebug() << e.getMessage().c_str() << Qt::endl;
+            }
+            if(!this->isInterruptionRequested()){
+                consuming = this->startConsuming();
+            }
+            continue;
+        }
+
+        // sleep until the next delivery or config change, or until an ack is due.
+        // While acks are held nothing more arrives, so recheck the consumers at a
+        // floor of FRAME_QUEUE_BLOCK_POLL_MS rather than spin with RADIO_ACK_MS=0
+        int timeout = -1;
+        if(unacked > 0){
+            timeout = holding ? qMax(this->ackIntervalMs, FRAME_QUEUE_BLOCK_POLL_MS)
+                              : int(qMax<qint64>(0, this->ackIntervalMs - oldest.elapsed()));
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = this->rxqu->getSocket();
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = this->wakePipe[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        if(poll(fds, 2, timeout) < 0 && errno != EINTR){
+            emit debugMessage(QString("radio poll failed: %1").arg(strerror(errno)));
+            QThread::msleep(100);   // don't spin if the descriptors went bad
+            continue;
+        }
+        if(fds[1].revents & POLLIN){
+            char buf[64];
+            while(read(this->wakePipe[0], buf, sizeof(buf)) > 0){
+            }
+        }
+
         try{
-            // check for data messages from the GNU radio process
-            this->rxqu->Get(AMQP_NOACK);
-
-            AMQPMessage * m = this->rxqu->getMessage();
-            if(m != NULL){
-                if (m->getMessageCount() > -1) {
-                    uint32_t j = 0;
-                    QString contentType = QString(m->getHeader("Content-type").c_str());
-                    if(contentType.compare("text/plain") == 0){
-                        QString msg = QString(m->getMessage(&j));
-                        qDebug() << "message\n"<< msg << "\nmessage key: "<<  m->getRoutingKey().c_str() << Qt::endl;
-                        qDebug() << "exchange: "<<  m->getExchange().c_str() << Qt::endl;
-                        qDebug() << "Content-type: "<< contentType << Qt::endl;
-                        qDebug() << "Content-encoding: "<< m->getHeader("Content-encoding").c_str() << Qt::endl;
-
-                        emit messageReady(msg); // messageReady signal
-                    }else if(contentType.compare("application/octet-stream") == 0){
-                        char* raw_data = m->getMessage(&j);
-                        this->populateFFT(raw_data, j);
-                        emit fftReady(this->fft); // fftReady signal
-                    }else if(contentType.compare("application/json") == 0){
-                        // some radio status info incoming
-                        this->updateStatus(QJsonDocument::fromJson(QByteArray(m->getMessage(&j))));
-                    }
+            // everything the broker has sent so far, frames may already be buffered from the last read
+            while(this->rxqu->NextDelivery(&noWait)){
+                AMQPMessage* m = this->rxqu->getMessage();
+                lastTag = m->getDeliveryTag();
+                if(unacked++ == 0){
+                    oldest.start();
+                }
+                this->handleMessage(m);
+                if(unacked >= this->ackBatch && !this->consumersStalled()){
+                    this->rxqu->Ack(lastTag);
+                    this->acksSent.fetchAndAddRelaxed(1);
+                    unacked = 0;
                 }
             }
 
-            // try to lock the config mutex
-            if(this->configMtx->try_lock()){
-                // check if the update flag is set (old and probably can be removed)
-                if(this->radioConfig->update){
-                    QByteArray json = this->radioConfig->packetizeData();
-                    this->ex->setHeader("Delivery-mode", 2);
-                    this->ex->setHeader("Content-type", "application/json");
-                    this->ex->setHeader("Content-encoding", "UTF-8");
-                    this->ex->Publish(json.data(), json.size(), "");
-                    this->radioConfig->update = false; // reset flag
+            // a stalled consumer keeps the acks, the broker stops once prefetch deliveries are out
+            if(unacked > 0 && (unacked >= this->ackBatch || oldest.elapsed() >= this->ackIntervalMs)){
+                bool stalled = this->consumersStalled();
+                if(stalled && !holding){
+                    this->ackHolds.fetchAndAddRelaxed(1);
                 }
-                // check for key value pairs
-                if(this->radioConfig->packets.size() > 0){
-                    QByteArray json = this->radioConfig->packetizeData();
-                    this->ex->setHeader("Delivery-mode", 2);
-                    this->ex->setHeader("Content-type", "application/json");
-                    this->ex->setHeader("Content-encoding", "UTF-8");
-                    this->ex->Publish(json.data(), json.size(), "");
+                holding = stalled;
+                if(!holding){
+                    this->rxqu->Ack(lastTag);
+                    this->acksSent.fetchAndAddRelaxed(1);
+                    unacked = 0;
                 }
-                this->configMtx->unlock();
             }
+
+            this->publishConfig();
         }catch(AMQPException e){
             emit debugMessage(QString(e.getMessage().c_str()));
             qDebug() << e.getMessage().c_str() << Qt::endl;
         }
-        QThread::usleep(1000); // 1 ms sleep
+    }
+}
+
+/**
+ * @brief Radio::startConsuming set up the radio_data consumer with the prefetch window
+ * @return false if the broker refused, the error is reported and run() tries again
+ */
+bool Radio::startConsuming(){
+    try{
+        std::function<char*(AMQPMessage*, size_t)> allocator = [this](AMQPMessage* m, size_t size){
+            return this->allocateBody(m, size);
+        };
+        this->rxqu->setBodyAllocator(allocator);
+        // acked deliveries, so no more than prefetch are in flight
+        this->rxqu->Qos(0, uint16_t(this->prefetch), 0);
+        this->rxqu->StartConsume(0);
+        this->rxqu->setParam(AMQP_MULTIPLE);    // one ack covers every delivery up to its tag
+    }catch(AMQPException e){
+        QString msg = QString("radio_data consumer not started, retrying: %1").arg(e.getMessage().c_str());
+        emit debugMessage(msg);
+        qDebug() << msg << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Radio::handleMessage act on one message from the GNU radio process
+ * @param m the delivery, only valid until the next one is read
+ */
+void Radio::handleMessage(AMQPMessage* m){
+    if(!this->pending.isNull()){
+        // an FFT frame, already in its own storage, receivers share it
+        if(!this->pendingWire || this->decodeWireFrame()){
+            for(FrameQueue* queue : this->frameQueues){
+                queue->push(this->pending);
+            }
+        }
+        this->pending.reset();
+        return;
+    }
+
+    uint32_t j = 0;
+    std::string contentTypeHeader = m->getHeader("Content-type");
+    QString contentType = QString(contentTypeHeader.c_str());
+    if(contentType.compare("text/plain") == 0){
+        QString msg = QString(m->getMessage(&j));
+        qDebug() << "message\n"<< msg << "\nmessage key: "<<  m->getRoutingKey().c_str() << Qt::endl;
+        qDebug() << "exchange: "<<  m->getExchange().c_str() << Qt::endl;
+        qDebug() << "Content-type: "<< contentType << Qt::endl;
+        qDebug() << "Content-encoding: "<< m->getHeader("Content-encoding").c_str() << Qt::endl;
+
+        emit messageReady(msg); // messageReady signal
+    }else if(contentType.compare("application/json") == 0){
+        // some radio status info incoming
+        this->updateStatus(QJsonDocument::fromJson(QByteArray(m->getMessage(&j))));
+    }
+}
+
+/**
+ * @brief Radio::decodeWireFrame point the pending frame at the bins after its wire header
+ * f64, f32 and int16 centi-dB bins are used where they landed, uint8 bins are
+ * widened into a float frame from the same pool. x-sdr-delta-zlib bins are first
+ * inflated into a frame of their own.
+ * @return false if the header is bad or the bins would not decode, the frame is dropped
+ */
+bool Radio::decodeWireFrame(){
+    FFTWireHeader header;
+    if(!parseFFTWireHeader(this->pending->constData(), this->pending->getSize(), this->pendingEncoded, &header)){
+        this->framesRejected.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    // a sequence number that goes backwards is a restarted producer, not a loss
+    if(this->haveSequence && header.sequence > this->lastSequence + 1){
+        this->framesLost.fetchAndAddRelaxed(header.sequence - this->lastSequence - 1);
+    }
+    this->lastSequence = header.sequence;
+    this->haveSequence = true;
+
+    // compressed bins are unpacked into a second frame, the compressed one goes back to the pool
+    size_t offset = header.headerSize;
+    if(this->pendingEncoded){
+        size_t bytes = size_t(header.bins)*fftWireSampleSize(FFTWireType(header.sampleType));
+        FFTFrameRef plain = this->framePool->acquire(SAMPLE_DOUBLE, bytes);
+        if(plain.isNull() || !this->inflater.decode(header, this->pending->constData() + offset, this->pending->getSize() - offset, plain->data())){
+            this->framesRejected.fetchAndAddRelaxed(1);
+            return false;
+        }
+        this->pending = std::move(plain);
+        offset = 0;
+    }
+
+    FFTFrameInfo info;
+    info.center = header.center;
+    info.span = header.span;
+    info.sequence = header.sequence;
+    info.timestamp = header.timestamp;
+    int bins = int(header.bins);
+    switch(header.sampleType){
+    case FFT_WIRE_F32:
+        this->pending->setPayload(SAMPLE_FLOAT, offset, bins, info);
+        break;
+    case FFT_WIRE_CDB16:
+        this->pending->setPayload(SAMPLE_CENTI_DB, offset, bins, info);
+        break;
+    case FFT_WIRE_U8:{
+        FFTFrameRef wide = this->framePool->acquire(SAMPLE_FLOAT, bins*sizeof(float));
+        if(wide.isNull()){
+            this->framesRejected.fetchAndAddRelaxed(1);
+            return false;
+        }
+        widenScaledBytes((const uint8_t*)this->pending->constData() + offset, bins,
+                         header.scaleMin, header.scaleStep, wide->mutableSamples<float>());
+        wide->setPayload(SAMPLE_FLOAT, 0, bins, info);
+        this->pending = std::move(wide);
+        break;
+    }
+    default:
+        this->pending->setPayload(SAMPLE_DOUBLE, offset, bins, info);
+        break;
+    }
+    return true;
+}
+
+/**
+ * @brief Radio::publishConfig send pending config changes to the GNU radio process
+ * a setter holding the config lock wakes the thread again once it lets go
+ */
+void Radio::publishConfig(){
+    // try to lock the config mutex
+    if(this->configMtx->try_lock()){
+        // check if the update flag is set (old and probably can be removed)
+        if(this->radioConfig->update){
+            QByteArray json = this->radioConfig->packetizeData();
+            this->ex->setHeader("Delivery-mode", 2);
+            this->ex->setHeader("Content-type", "application/json");
+            this->ex->setHeader("Content-encoding", "UTF-8");
+            this->ex->Publish(json.data(), json.size(), "");
+            this->radioConfig->update = false; // reset flag
+        }
+        // check for key value pairs
+        if(this->radioConfig->packets.size() > 0){
+            QByteArray json = this->radioConfig->packetizeData();
+            this->ex->setHeader("Delivery-mode", 2);
+            this->ex->setHeader("Content-type", "application/json");
+            this->ex->setHeader("Content-encoding", "UTF-8");
+            this->ex->Publish(json.data(), json.size(), "");
+        }
+        this->configMtx->unlock();
+    }
+}
+
+/**
+ * @brief Radio::releaseConfig unlock the config after a change and wake the radio thread to send it
+ */
+void Radio::releaseConfig(){
+    this->configMtx->unlock();
+    this->wake();
+}
+
+/**
+ * @brief Radio::wake get the radio thread out of poll, safe from any thread
+ */
+void Radio::wake(){
+    if(this->wakePipe[1] >= 0){
+        char c = 1;
+        ssize_t n = write(this->wakePipe[1], &c, 1); // a full pipe already means a wakeup is pending
+        (void)n;
     }
 }
@@ -11,11 +11,25 @@
 #include <QProcess>
 #include <QFile>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QDir>
 #include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #include "AMQPcpp.h"
 #include <limits>
 #include "parse_csv.h"
+#include "sampletype.h"
+#include "fftframe.h"
+#include "fftwire.h"
+#include "framequeue.h"
+
+#define RADIO_PREFETCH      64      // deliveries the broker may send ahead of our acks
+#define RADIO_ACK_BATCH     16      // deliveries covered by one ack
+#define RADIO_ACK_MS        50      // longest a delivery waits for its ack while the consumers keep up
+#define RADIO_CONSUME_RETRY_MS  1000    // wait between attempts to start consuming radio_data
 
 /**
  * @brief The RadioConfig class
@@ -44,6 +58,8 @@ public:
     bool update             = false;    // flag to indicate that the SDR needs to be updated with config info
     QVector<QPair<QString,QJsonValue>> packets;       // store packets to send out
     QString protocolStr     = "";
+    QString fftFormat       = "";       // content type asked of the radio process, empty for its default
+    QString fftEncoding     = "";       // content encoding asked of the radio process, empty for none
 private:
     QJsonObject* json;
 };
@@ -151,6 +167,9 @@ static QStringList csv_headers = {"frequency", "description", "protocol", "tag",
 /**
  * @brief The Radio class will run as a QThread
  * handles communication with the GNU radio process
+ * The thread sleeps in poll() until the broker socket has deliveries or a config
+ * setter wakes it through a pipe, every wakeup drains all buffered deliveries.
+ * FFT frames go to each consumer through its own bounded FrameQueue.
  */
 class Radio : public QThread
 {
@@ -172,7 +191,14 @@ public:
     double  getSignalPower() { return this->radioStatus->signalPower; }
     QString getName       () { return this->radioStatus->name; }
     bool    isSearching   () { return this->radioStatus->isSearching; }
+    quint64 getFramesLost () { return this->framesLost.loadAcquire(); }
+    quint64 getFramesRejected() { return this->framesRejected.loadAcquire(); }
     void    setupRadio    ();
+    void    addFrameQueue (FrameQueue* queue);
+    void    setAckPolicy  (int prefetch, int batch, int intervalMs);
+    void    stop          ();
+    quint64 getAcksSent   () { return this->acksSent.loadAcquire(); }
+    quint64 getAckHolds   () { return this->ackHolds.loadAcquire(); }
     QString radioProgramPath = "/home/adam/Documents/hello_world/rcv.py";
     QString countiesFilePath = "/home/adam/Documents/sdr_gnu_radio_app/tools/us_counties.csv";
     QString appDataDirPath = "/var/lib/sdrapp";
@@ -206,6 +232,8 @@ public slots:
     void    configureRadio  (const RadioConfig& config);
     void    updateStatus    (const QJsonDocument& json);
     void    setProtocol     (const QString& str);
+    void    setFftFormat    (FFTWireType type);
+    void    setFftCompression(bool compress);
     void    addChannel      (const Channel& ch);
     void    addChannelsToScanList(QVector<Channel> channels);
     void    saveChannels    ();
@@ -222,19 +250,40 @@ private:
     AMQPExchange * ex;
     AMQPQueue * txqu;
     QMutex* configMtx;
-    QVector<double> fft;
+    FFTFramePool* framePool;    // FFT payloads are assembled straight into pooled frames
+    FFTFrameRef pending;        // frame the current delivery's body went into
+    bool pendingWire = false;   // pending holds an application/x-sdr-fft body, header and all
+    bool pendingEncoded = false;    // and its bins are x-sdr-delta-zlib compressed
+    FFTWireInflater inflater;
+    QVector<FrameQueue*> frameQueues;   // one per consumer, only changed before the thread starts
+    int prefetch = RADIO_PREFETCH;
+    int ackBatch = RADIO_ACK_BATCH;
+    int ackIntervalMs = RADIO_ACK_MS;
+    QAtomicInteger<quint64> acksSent;
+    QAtomicInteger<quint64> ackHolds;   // times acks were held back because a consumer stalled
+    bool consumersStalled();
+    quint64 lastSequence = 0;
+    bool haveSequence = false;
+    QAtomicInteger<quint64> framesLost;     // sequence gaps in wire frames
+    QAtomicInteger<quint64> framesRejected; // wire frames with a bad header or bins that would not decode
     QVector<Channel> channels; // stores radio channels
     QString channelSavePath = "";
     QTimer * saveTimer;
     QVector<Channel>::iterator currentChannel;
-    void populateFFT(char* data, int size);
+    char* allocateBody(AMQPMessage* m, size_t size);
+    bool startConsuming();
+    void handleMessage(AMQPMessage* m);
+    bool decodeWireFrame();
+    void publishConfig();
+    void releaseConfig();
+    void wake();
+    int wakePipe[2] = { -1, -1 };   // written by config setters and stop() to wake the radio thread
     double centerFrequency  = 500000.0; // 500 kHz
     double bandwidth        = 1000.0;   // 1 kHz
 
 signals:
     void messageReady(const QString& msg);
     void debugMessage(const QString& msg);
-    void fftReady(const QVector<double>& fft);
     void statusUpdate(const RadioStatus& status);
 };
 
@@ -0,0 +1,166 @@
+#include "resample.h"
+
+/**
+ * @brief Resampler::Resampler constructor
+ * @param mode how bins are combined into pixels
+ */
+Resampler::Resampler(ResampleMode mode){
+    this->mode = mode;
+}
+
+Resampler::~Resampler(){
+    free(this->binStart);
+    free(this->binEnd);
+    free(this->lerpIndex);
+    free(this->lerpFrac);
+}
+
+/**
+ * @brief Resampler::setMode change how bins are combined, tables do not need rebuilding
+ * @param mode
+ */
+void Resampler::setMode(ResampleMode mode){
+    this->mode = mode;
+}
+
+/**
+ * @brief Resampler::setView zoom in on part of the frame, tables are rebuilt on the next frame
+ * @param start left edge of the view as a fraction of the frame, 0.0 to 1.0 - span
+ * @param span width of the view as a fraction of the frame, 1.0 shows everything
+ */
+void Resampler::setView(double start, double span){
+    span = span > 0.0 && span < 1.0 ? span : 1.0;
+    start = start > 0.0 ? (start < 1.0 - span ? start : 1.0 - span) : 0.0;
+    if(start == this->viewStart && span == this->viewSpan){
+        return;
+    }
+    this->viewStart = start;
+    this->viewSpan = span;
+    this->srcSize = 0;  // forces buildTables
+}
+
+/**
+ * @brief Resampler::resample reduce (or stretch) src into dest
+ * @param src source bins, double, float or int16 centi-dB
+ * @param srcSize number of source bins
+ * @param dest destination pixels, fully overwritten
+ * @param destSize number of destination pixels
+ */
+template<typename T>
+void Resampler::resample(const T* src, int srcSize, T* dest, int destSize){
+    if(srcSize <= 0 || destSize <= 0){
+        return;
+    }
+    if(srcSize != this->srcSize || destSize != this->destSize){
+        this->buildTables(srcSize, destSize);
+    }
+
+    if(this->interpolate){
+        // zoomed past one bin per pixel, repeating bins would show steps
+        this->linear(src, dest);
+        return;
+    }
+    switch(this->mode){
+    case RESAMPLE_MEAN:
+    case RESAMPLE_LINEAR:
+        this->mean(src, dest);
+        break;
+    case RESAMPLE_MAX_HOLD:
+    default:
+        this->maxHold(src, dest);
+        break;
+    }
+}
+
+/**
+ * @brief Resampler::buildTables precompute which bins of the view land on which pixel
+ * @param srcSize number of source bins
+ * @param destSize number of destination pixels
+ * Every pixel gets at least one bin. Indices are into the whole frame.
+ */
+void Resampler::buildTables(int srcSize, int destSize){
+    this->srcSize = srcSize;
+    this->destSize = destSize;
+
+    this->binStart  = (int*)realloc(this->binStart, destSize*sizeof(int));
+    this->binEnd    = (int*)realloc(this->binEnd, destSize*sizeof(int));
+    this->lerpIndex = (int*)realloc(this->lerpIndex, destSize*sizeof(int));
+    this->lerpFrac  = (float*)realloc(this->lerpFrac, destSize*sizeof(float));
+
+    bool full = this->isFullView();
+    double first = this->viewStart*srcSize;                     // bin position of the left edge
+    double binsPerPixel = this->viewSpan*srcSize/destSize;
+    this->interpolate = binsPerPixel < 1.0;
+
+    for(int i = 0; i < destSize; i++){
+        int start, end;
+        if(full){
+            start = int((long long)i*srcSize/destSize);
+            end   = int((long long)(i + 1)*srcSize/destSize);
+        }else{
+            start = int(first + i*binsPerPixel);
+            end   = int(first + (i + 1)*binsPerPixel);
+            start = start < srcSize ? start : srcSize - 1;
+            end   = end < srcSize ? end : srcSize;
+        }
+        this->binStart[i] = start;
+        this->binEnd[i]   = end > start ? end : start + 1;
+
+        // centre of pixel i expressed in bins, clamped to the outer bin centres
+        double pos = first + (i + 0.5)*binsPerPixel - 0.5;
+        if(pos < 0.0){
+            pos = 0.0;
+        }else if(pos > srcSize - 1){
+            pos = srcSize - 1;
+        }
+        int left = int(pos);
+        if(left > srcSize - 2){
+            left = srcSize > 1 ? srcSize - 2 : 0;
+        }
+        this->lerpIndex[i] = left;
+        this->lerpFrac[i]  = srcSize > 1 ? float(pos - left) : 0.0f;
+    }
+}
+
+template<typename T>
+void Resampler::maxHold(const T* src, T* dest){
+    for(int i = 0; i < this->destSize; i++){
+        const int end = this->binEnd[i];
+        T peak = src[this->binStart[i]];
+        for(int j = this->binStart[i] + 1; j < end; j++){
+            peak = src[j] > peak ? src[j] : peak;
+        }
+        dest[i] = peak;
+    }
+}
+
+template<typename T>
+void Resampler::mean(const T* src, T* dest){
+    for(int i = 0; i < this->destSize; i++){
+        const int end = this->binEnd[i];
+        typename SampleTraits<T>::Accumulator sum = 0;
+        for(int j = this->binStart[i]; j < end; j++){
+            sum += src[j];
+        }
+        dest[i] = T(sum/(end - this->binStart[i]));
+    }
+}
+
+template<typename T>
+void Resampler::linear(const T* src, T* dest){
+    if(this->srcSize == 1){
+        for(int i = 0; i < this->destSize; i++){
+            dest[i] = src[0];
+        }
+        return;
+    }
+    for(int i = 0; i < this->destSize; i++){
+        const int left = this->lerpIndex[i];
+        const float frac = this->lerpFrac[i];
+        dest[i] = T(src[left] + (src[left + 1] - src[left])*frac);
+    }
+}
+
+template void Resampler::resample<double>(const double* src, int srcSize, double* dest, int destSize);
+template void Resampler::resample<float>(const float* src, int srcSize, float* dest, int destSize);
+template void Resampler::resample<int16_t>(const int16_t* src, int srcSize, int16_t* dest, int destSize);
@@ -0,0 +1,55 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <cstdlib>
+#include "sampletype.h"
+
+/**
+ * @brief The ResampleMode enum selects how FFT bins are reduced to display pixels
+ */
+enum ResampleMode {
+    RESAMPLE_MAX_HOLD,  // loudest bin under each pixel, keeps narrow carriers visible
+    RESAMPLE_MEAN,      // average of the bins under each pixel
+    RESAMPLE_LINEAR     // interpolate between neighbouring bins, averages when downsampling
+};
+
+/**
+ * @brief The Resampler class maps an array of FFT bins onto an array of pixels in O(src + dest)
+ * The bin-to-pixel index tables are built once per (src, dest) pair and reused
+ * for every frame until either size or the mode changes.
+ * Frames stay in their sample type, instantiated for double, float and int16 centi-dB.
+ * A view selects the part of the frame to show, the tables then index straight
+ * into the full frame so the visible slice is never copied. With fewer bins than
+ * pixels, every mode interpolates between neighbouring bins.
+ */
+class Resampler
+{
+public:
+    explicit Resampler(ResampleMode mode = RESAMPLE_MAX_HOLD);
+    ~Resampler();
+    void setMode(ResampleMode mode);
+    ResampleMode getMode() { return mode; }
+    void setView(double start, double span);
+    double getViewStart() { return viewStart; }
+    double getViewSpan() { return viewSpan; }
+    bool isFullView() { return viewStart == 0.0 && viewSpan == 1.0; }
+    template<typename T> void resample(const T* src, int srcSize, T* dest, int destSize);
+
+private:
+    void buildTables(int srcSize, int destSize);
+    template<typename T> void maxHold(const T* src, T* dest);
+    template<typename T> void mean(const T* src, T* dest);
+    template<typename T> void linear(const T* src, T* dest);
+    ResampleMode mode;
+    int srcSize = 0;
+    int destSize = 0;
+    double viewStart = 0.0;     // left edge of the view as a fraction of the frame
+    double viewSpan = 1.0;      // width of the view as a fraction of the frame
+    bool interpolate = false;   // fewer than one bin per pixel in the view
+    int* binStart = nullptr;    // pixel i covers bins binStart[i] up to binEnd[i] (exclusive)
+    int* binEnd = nullptr;
+    int* lerpIndex = nullptr;   // left bin for each pixel when interpolating
+    float* lerpFrac = nullptr;  // weight of the right bin for each pixel
+};
+
+#endif // RESAMPLE_H
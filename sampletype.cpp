@@ -0,0 +1,69 @@
+#include "sampletype.h"
+
+/**
+ * @brief sampleSize
+ * @param type
+ * @return bytes per sample
+ */
+int sampleSize(SampleType type){
+    switch(type){
+    case SAMPLE_FLOAT:
+        return 4;
+    case SAMPLE_CENTI_DB:
+        return 2;
+    default:
+        return 8;
+    }
+}
+
+/**
+ * @brief sampleTypeName
+ * @param type
+ * @return the name used for the type in content types, "f64", "f32" or "cdb16"
+ */
+const char* sampleTypeName(SampleType type){
+    switch(type){
+    case SAMPLE_FLOAT:
+        return "f32";
+    case SAMPLE_CENTI_DB:
+        return "cdb16";
+    default:
+        return "f64";
+    }
+}
+
+/**
+ * @brief sampleTypeFromContentType work out how the bins of an FFT message are encoded
+ * @param contentType message content type, "application/octet-stream" optionally
+ * followed by a "; sample=f64", "; sample=f32" or "; sample=cdb16" parameter
+ * @param type set to the sample type if the content type is an FFT frame
+ * @return false if the content type is not an FFT frame or names an unknown sample type
+ * a bare "application/octet-stream" is doubles, which is what older radio processes send
+ */
+bool sampleTypeFromContentType(const char* contentType, SampleType* type){
+    static const char base[] = "application/octet-stream";
+    if(strncmp(contentType, base, sizeof(base) - 1) != 0){
+        return false;
+    }
+    const char* p = contentType + sizeof(base) - 1;
+    while(*p == ' ' || *p == ';'){
+        p++;
+    }
+    if(*p == '\0'){
+        *type = SAMPLE_DOUBLE;
+        return true;
+    }
+    if(strncmp(p, "sample=", 7) != 0){
+        return false;
+    }
+    p += 7;
+    for(int t = SAMPLE_DOUBLE; t <= SAMPLE_CENTI_DB; t++){
+        const char* name = sampleTypeName(SampleType(t));
+        size_t len = strlen(name);
+        if(strncmp(p, name, len) == 0 && (p[len] == '\0' || p[len] == ';' || p[len] == ' ')){
+            *type = SampleType(t);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef SAMPLETYPE_H
+#define SAMPLETYPE_H
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+
+#define CENTI_DB_SCALE      100.0   // int16 samples are hundredths of a dB, +-327 dB
+
+/**
+ * @brief The SampleType enum lists the encodings FFT bins can arrive in, all power in dB
+ */
+enum SampleType {
+    SAMPLE_DOUBLE,      // 8 byte IEEE doubles, what the radio process has always sent
+    SAMPLE_FLOAT,       // 4 byte IEEE floats
+    SAMPLE_CENTI_DB     // 2 byte signed integers in hundredths of a dB
+};
+
+/**
+ * @brief The SampleTraits struct describes how each sample type maps to dB
+ * toDb widens a sample to dB, fromDb narrows dB to a sample, Accumulator
+ * is wide enough to sum a pixel's worth of samples.
+ */
+template<typename T> struct SampleTraits;
+
+template<> struct SampleTraits<double> {
+    typedef double Accumulator;
+    static double toDb(double value) { return value; }
+    static double fromDb(double db) { return db; }
+};
+
+template<> struct SampleTraits<float> {
+    typedef float Accumulator;
+    static double toDb(float value) { return value; }
+    static float fromDb(double db) { return float(db); }
+};
+
+template<> struct SampleTraits<int16_t> {
+    typedef int32_t Accumulator;
+    static double toDb(int16_t value) { return value/CENTI_DB_SCALE; }
+    static int16_t fromDb(double db){
+        double centi = db*CENTI_DB_SCALE;
+        if(!(centi > INT16_MIN)){
+            return INT16_MIN;   // also NaN, the bottom of the colormap
+        }
+        return centi < INT16_MAX ? int16_t(lrint(centi)) : int16_t(INT16_MAX);
+    }
+};
+
+/**
+ * @brief widenSamples convert a row of samples to dB doubles
+ * @param src n samples
+ * @param n
+ * @param dest n values in dB
+ */
+template<typename T>
+void widenSamples(const T* src, int n, double* dest){
+    for(int i = 0; i < n; i++){
+        dest[i] = SampleTraits<T>::toDb(src[i]);
+    }
+}
+
+int sampleSize(SampleType type);
+const char* sampleTypeName(SampleType type);
+bool sampleTypeFromContentType(const char* contentType, SampleType* type);
+
+#endif // SAMPLETYPE_H
@@ -0,0 +1,627 @@
+#include "spectrogramfile.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief encodeVarint write value as a little-endian base-128 varint
+ * @param value
+ * @param out at least 5 bytes
+ * @return number of bytes written
+ */
+int encodeVarint(uint32_t value, uchar* out){
+    int n = 0;
+    while(value >= 0x80){
+        out[n++] = uchar(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = uchar(value);
+    return n;
+}
+
+/**
+ * @brief decodeVarint read a base-128 varint and advance past it
+ * @param in read position, advanced past the varint
+ * @param end end of the readable data
+ * @return decoded value, 0 past the end of the data
+ */
+uint32_t decodeVarint(const uchar** in, const uchar* end){
+    const uchar* p = *in;
+    uint32_t value = 0;
+    int shift = 0;
+    while(p < end && shift < 35){
+        uchar b = *p++;
+        value |= uint32_t(b & 0x7F) << shift;
+        if(!(b & 0x80)){
+            break;
+        }
+        shift += 7;
+    }
+    *in = p;
+    return value;
+}
+
+/**
+ * @brief pad8 bytes of padding that keep the next block 8-byte aligned
+ * @param bytes
+ */
+static inline int pad8(int64_t bytes){
+    return int((8 - bytes % 8) % 8);
+}
+
+
+SpectrogramWriter::SpectrogramWriter(QObject *parent) :
+    QObject(parent)
+{
+}
+
+SpectrogramWriter::~SpectrogramWriter(){
+    this->close();
+    free(this->payload);
+    free(this->previous);
+}
+
+/**
+ * @brief SpectrogramWriter::open start a new recording, replaces an existing file
+ * @param path
+ * @param encoding SPECTROGRAM_RAW_F64 for zero-copy playback, SPECTROGRAM_DELTA_VARINT for long recordings
+ * @return false if the file could not be created
+ */
+bool SpectrogramWriter::open(QString path, SpectrogramEncoding encoding){
+    this->close();
+
+    this->file.setFileName(path);
+    if(!this->file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        return false;
+    }
+
+    this->encoding = encoding;
+    this->capacity = 0; // row size depends on the encoding, resize on the first row
+    this->rows = 0;
+    this->blocks = 0;
+    this->index.clear();
+    this->index.reserve(1024);
+
+    SpectrogramFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SPECTROGRAM_MAGIC;
+    header.version = SPECTROGRAM_VERSION;
+    header.encoding = uint16_t(encoding);
+    header.rowsPerBlock = SPECTROGRAM_ROWS_PER_BLOCK;
+    this->file.write((const char*)&header, sizeof(header));
+    this->offset = sizeof(header);
+
+    return true;
+}
+
+/**
+ * @brief SpectrogramWriter::close flush the last block, write the index and close the file
+ */
+void SpectrogramWriter::close(){
+    if(!this->file.isOpen()){
+        return;
+    }
+    this->flushBlock();
+
+    SpectrogramIndexHeader indexHeader;
+    indexHeader.magic = SPECTROGRAM_INDEX_MAGIC;
+    indexHeader.count = uint32_t(this->index.size());
+    this->file.write((const char*)&indexHeader, sizeof(indexHeader));
+    this->file.write((const char*)this->index.constData(), this->index.size()*sizeof(SpectrogramIndexEntry));
+
+    // the index goes in last so an interrupted recording still has a valid header
+    SpectrogramFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SPECTROGRAM_MAGIC;
+    header.version = SPECTROGRAM_VERSION;
+    header.encoding = uint16_t(this->encoding);
+    header.rowsPerBlock = SPECTROGRAM_ROWS_PER_BLOCK;
+    header.indexOffset = this->offset;
+    this->file.seek(0);
+    this->file.write((const char*)&header, sizeof(header));
+
+    this->file.close();
+}
+
+/**
+ * @brief SpectrogramWriter::reserve size the block buffers for rows of bins values
+ * @param bins
+ * only called when the bin count grows, recording a row never allocates
+ */
+void SpectrogramWriter::reserve(int bins){
+    // a centi-dB delta fits in 17 bits, three varint bytes
+    size_t rowBytes = this->encoding == SPECTROGRAM_RAW_F64 ? bins*sizeof(double) : bins*3;
+    this->payload = (uchar*)realloc(this->payload, rowBytes*SPECTROGRAM_ROWS_PER_BLOCK);
+    this->previous = (int16_t*)realloc(this->previous, bins*sizeof(int16_t));
+    this->capacity = bins;
+}
+
+/**
+ * @brief SpectrogramWriter::appendFFT slot to record an fft frame
+ * @param fft
+ */
+void SpectrogramWriter::appendFFT(const QVector<double>& fft){
+    this->appendRow(fft.constData(), fft.size());
+}
+
+/**
+ * @brief SpectrogramWriter::appendFrame slot for frames straight from the radio, recordings are kept in doubles
+ * @param frame shared with the other receivers, only read
+ */
+void SpectrogramWriter::appendFrame(const FFTFrameRef& frame){
+    const FFTFrameInfo& info = frame->getInfo();
+    if(info.span > 0.0 && (info.center != this->centerFrequency || info.span != this->bandwidth)){
+        this->flushBlock(); // a block has a single tuning
+        this->centerFrequency = info.center;
+        this->bandwidth = info.span;
+    }
+    this->frameTuning = info.span > 0.0;
+    int64_t timestamp = info.timestamp > 0 ? info.timestamp/1000 : QDateTime::currentMSecsSinceEpoch();
+
+    int bins = frame->getBins();
+    switch(frame->getType()){
+    case SAMPLE_FLOAT:
+        this->widened.resize(bins);
+        widenSamples(frame->samples<float>(), bins, this->widened.data());
+        this->recordRow(this->widened.constData(), bins, timestamp);
+        break;
+    case SAMPLE_CENTI_DB:
+        this->widened.resize(bins);
+        widenSamples(frame->samples<int16_t>(), bins, this->widened.data());
+        this->recordRow(this->widened.constData(), bins, timestamp);
+        break;
+    default:
+        this->recordRow(frame->samples<double>(), bins, timestamp);
+        break;
+    }
+}
+
+/**
+ * @brief SpectrogramWriter::appendRow record one row, written out when the block is full
+ * @param values fft values in dB
+ * @param bins number of values
+ */
+void SpectrogramWriter::appendRow(const double* values, int bins){
+    this->recordRow(values, bins, QDateTime::currentMSecsSinceEpoch());
+}
+
+/**
+ * @brief SpectrogramWriter::recordRow record one row with its time
+ * @param values fft values in dB
+ * @param bins number of values
+ * @param timestamp ms since epoch the row was captured
+ */
+void SpectrogramWriter::recordRow(const double* values, int bins, int64_t timestamp){
+    if(!this->file.isOpen() || bins <= 0){
+        return;
+    }
+    if(this->rows > 0 && bins != this->bins){
+        this->flushBlock(); // a block has a single bin count
+    }
+    if(bins > this->capacity){
+        this->reserve(bins);
+    }
+    this->bins = bins;
+
+    if(this->rows == 0){
+        this->payloadBytes = 0;
+        memset(this->previous, 0, bins*sizeof(int16_t)); // first row of a block is a delta to zero
+    }
+    this->times[this->rows] = timestamp;
+
+    uchar* out = this->payload + this->payloadBytes;
+    if(this->encoding == SPECTROGRAM_RAW_F64){
+        memcpy(out, values, bins*sizeof(double));
+        out += bins*sizeof(double);
+    }else{
+        for(int i = 0; i < bins; i++){
+            double v = values[i]*100.0;
+            int32_t q = v > -32768.0 ? (v < 32767.0 ? int32_t(lround(v)) : 32767) : -32768; // NaN ends up at the bottom
+            int32_t delta = q - this->previous[i];
+            this->previous[i] = int16_t(q);
+            out += encodeVarint((uint32_t(delta) << 1) ^ uint32_t(delta >> 31), out);
+        }
+    }
+    this->payloadBytes = int(out - this->payload);
+
+    this->rows++;
+    if(this->rows == SPECTROGRAM_ROWS_PER_BLOCK){
+        this->flushBlock();
+    }
+}
+
+/**
+ * @brief SpectrogramWriter::setCenterFreq slot to follow retunes, starts a new block
+ * @param freq center frequency in Hz
+ * ignored while the frames say what they were captured on
+ */
+void SpectrogramWriter::setCenterFreq(double freq){
+    if(!this->frameTuning && freq != this->centerFrequency){
+        this->flushBlock();
+        this->centerFrequency = freq;
+    }
+}
+
+/**
+ * @brief SpectrogramWriter::setBandwidth slot to follow bandwidth changes, starts a new block
+ * @param bw bandwidth in Hz
+ * ignored while the frames say what they were captured on
+ */
+void SpectrogramWriter::setBandwidth(double bw){
+    if(!this->frameTuning && bw != this->bandwidth){
+        this->flushBlock();
+        this->bandwidth = bw;
+    }
+}
+
+/**
+ * @brief SpectrogramWriter::flushBlock write the rows collected so far as one block
+ */
+void SpectrogramWriter::flushBlock(){
+    if(this->rows == 0 || !this->file.isOpen()){
+        this->rows = 0;
+        return;
+    }
+
+    if(this->blocks % SPECTROGRAM_INDEX_STRIDE == 0){
+        SpectrogramIndexEntry entry;
+        entry.timestamp = this->times[0];
+        entry.offset = this->offset;
+        this->index.append(entry);
+    }
+
+    SpectrogramBlockHeader header;
+    header.magic = SPECTROGRAM_BLOCK_MAGIC;
+    header.encoding = uint16_t(this->encoding);
+    header.rows = uint16_t(this->rows);
+    header.bins = uint32_t(this->bins);
+    header.payloadBytes = uint32_t(this->payloadBytes);
+    header.centerFrequency = this->centerFrequency;
+    header.bandwidth = this->bandwidth;
+    header.timestamp = this->times[0];
+    header.reserved = 0;
+
+    static const char zeros[8] = {0};
+    int pad = pad8(this->payloadBytes);
+    this->file.write((const char*)&header, sizeof(header));
+    this->file.write((const char*)this->times, this->rows*sizeof(int64_t));
+    this->file.write((const char*)this->payload, this->payloadBytes);
+    this->file.write(zeros, pad);
+
+    this->offset += sizeof(header) + this->rows*sizeof(int64_t) + this->payloadBytes + pad;
+    this->blocks++;
+    this->rows = 0;
+}
+
+
+SpectrogramReader::SpectrogramReader(){
+}
+
+SpectrogramReader::~SpectrogramReader(){
+    this->close();
+    free(this->decoded);
+    free(this->levels);
+}
+
+/**
+ * @brief SpectrogramReader::open map a recording and position at its first row
+ * @param path
+ * @return false if the file can not be mapped or holds no rows
+ */
+bool SpectrogramReader::open(QString path){
+    this->close();
+
+    this->file.setFileName(path);
+    if(!this->file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    this->size = this->file.size();
+    if(this->size < qint64(sizeof(SpectrogramFileHeader))){
+        this->close();
+        return false;
+    }
+    this->map = this->file.map(0, this->size);
+    if(this->map == nullptr){
+        this->close();
+        return false;
+    }
+
+    const SpectrogramFileHeader* header = (const SpectrogramFileHeader*)this->map;
+    if(header->magic != SPECTROGRAM_MAGIC || header->version != SPECTROGRAM_VERSION){
+        this->close();
+        return false;
+    }
+
+    if(!this->loadIndex()){
+        this->rebuildIndex();
+    }
+    if(this->index.isEmpty()){
+        this->close();
+        return false;
+    }
+
+    // walk the blocks after the last index entry to find the end of the recording
+    qint64 off = this->index.last().offset;
+    for(const SpectrogramBlockHeader* b = this->blockAt(off); b != nullptr; b = this->blockAt(off)){
+        const int64_t* times = (const int64_t*)(this->map + off + sizeof(SpectrogramBlockHeader));
+        this->lastTime = times[b->rows - 1];
+        off = this->nextBlockOffset(off);
+    }
+
+    return this->seek(this->index.first().timestamp);
+}
+
+/**
+ * @brief SpectrogramReader::close unmap and close the recording
+ */
+void SpectrogramReader::close(){
+    if(this->map != nullptr){
+        this->file.unmap(this->map);
+        this->map = nullptr;
+    }
+    this->file.close();
+    this->index.clear();
+    this->size = 0;
+    this->dataEnd = 0;
+    this->lastTime = 0;
+    this->block = nullptr;
+}
+
+/**
+ * @brief SpectrogramReader::loadIndex use the index written when the recording was closed
+ * @return false if there is no usable index
+ */
+bool SpectrogramReader::loadIndex(){
+    const SpectrogramFileHeader* header = (const SpectrogramFileHeader*)this->map;
+    qint64 off = header->indexOffset;
+    if(off < qint64(sizeof(SpectrogramFileHeader)) || off + qint64(sizeof(SpectrogramIndexHeader)) > this->size){
+        return false;
+    }
+
+    const SpectrogramIndexHeader* indexHeader = (const SpectrogramIndexHeader*)(this->map + off);
+    qint64 entries = off + sizeof(SpectrogramIndexHeader);
+    if(indexHeader->magic != SPECTROGRAM_INDEX_MAGIC || indexHeader->count == 0 ||
+       entries + qint64(indexHeader->count*sizeof(SpectrogramIndexEntry)) > this->size){
+        return false;
+    }
+
+    this->index.resize(indexHeader->count);
+    memcpy(this->index.data(), this->map + entries, indexHeader->count*sizeof(SpectrogramIndexEntry));
+    this->dataEnd = off;
+    return true;
+}
+
+/**
+ * @brief SpectrogramReader::rebuildIndex index a recording that was not closed cleanly
+ * a partly written last block is ignored
+ */
+void SpectrogramReader::rebuildIndex(){
+    this->index.clear();
+    this->dataEnd = this->size;
+
+    qint64 off = sizeof(SpectrogramFileHeader);
+    int blocks = 0;
+    for(const SpectrogramBlockHeader* b = this->blockAt(off); b != nullptr; b = this->blockAt(off)){
+        if(blocks % SPECTROGRAM_INDEX_STRIDE == 0){
+            SpectrogramIndexEntry entry;
+            entry.timestamp = b->timestamp;
+            entry.offset = off;
+            this->index.append(entry);
+        }
+        off = this->nextBlockOffset(off);
+        blocks++;
+    }
+    this->dataEnd = off;
+}
+
+/**
+ * @brief SpectrogramReader::blockAt validate the block at offset
+ * @param offset file offset of a block header
+ * @return the block header in the mapping, nullptr if there is no complete block there
+ */
+const SpectrogramBlockHeader* SpectrogramReader::blockAt(qint64 offset){
+    if(offset < qint64(sizeof(SpectrogramFileHeader)) || offset + qint64(sizeof(SpectrogramBlockHeader)) > this->dataEnd){
+        return nullptr;
+    }
+    const SpectrogramBlockHeader* b = (const SpectrogramBlockHeader*)(this->map + offset);
+    if(b->magic != SPECTROGRAM_BLOCK_MAGIC || b->rows == 0 || b->bins == 0 || b->encoding > SPECTROGRAM_DELTA_VARINT){
+        return nullptr;
+    }
+    if(b->encoding == SPECTROGRAM_RAW_F64 && b->payloadBytes != uint64_t(b->rows)*b->bins*sizeof(double)){
+        return nullptr;
+    }
+    if(offset + qint64(sizeof(SpectrogramBlockHeader) + b->rows*sizeof(int64_t)) + b->payloadBytes > this->dataEnd){
+        return nullptr;
+    }
+    return b;
+}
+
+/**
+ * @brief SpectrogramReader::nextBlockOffset
+ * @param offset file offset of a valid block
+ * @return file offset of the block after it
+ */
+qint64 SpectrogramReader::nextBlockOffset(qint64 offset){
+    const SpectrogramBlockHeader* b = (const SpectrogramBlockHeader*)(this->map + offset);
+    return offset + sizeof(SpectrogramBlockHeader) + b->rows*sizeof(int64_t) + b->payloadBytes + pad8(b->payloadBytes);
+}
+
+/**
+ * @brief SpectrogramReader::enterBlock make the block at offset current, positioned at its first row
+ * @param offset file offset of a valid block
+ */
+void SpectrogramReader::enterBlock(qint64 offset){
+    this->blockOffset = offset;
+    this->block = (const SpectrogramBlockHeader*)(this->map + offset);
+    this->rowTimes = (const int64_t*)(this->map + offset + sizeof(SpectrogramBlockHeader));
+    this->payload = (const uchar*)(this->rowTimes + this->block->rows);
+    this->cursor = this->payload;
+    this->row = 0;
+
+    if(this->block->encoding == SPECTROGRAM_DELTA_VARINT){
+        int bins = int(this->block->bins);
+        if(bins > this->capacity){
+            this->decoded = (double*)realloc(this->decoded, bins*sizeof(double));
+            this->levels = (int16_t*)realloc(this->levels, bins*sizeof(int16_t));
+            this->capacity = bins;
+        }
+        memset(this->levels, 0, bins*sizeof(int16_t));
+    }
+}
+
+/**
+ * @brief SpectrogramReader::seek position at the first row recorded at or after timestamp
+ * @param timestamp ms since epoch
+ * @return false if nothing is open
+ */
+bool SpectrogramReader::seek(qint64 timestamp){
+    if(this->index.isEmpty()){
+        return false;
+    }
+
+    // last index entry starting at or before timestamp
+    const SpectrogramIndexEntry* first = this->index.constData();
+    const SpectrogramIndexEntry* last = first + this->index.size();
+    const SpectrogramIndexEntry* entry = std::upper_bound(first, last, timestamp,
+        [](qint64 t, const SpectrogramIndexEntry& e){ return t < e.timestamp; });
+    if(entry != first){
+        entry--;
+    }
+
+    // at most SPECTROGRAM_INDEX_STRIDE blocks to the one holding timestamp
+    qint64 off = entry->offset;
+    if(this->blockAt(off) == nullptr){
+        return false;
+    }
+    for(;;){
+        qint64 next = this->nextBlockOffset(off);
+        const SpectrogramBlockHeader* b = this->blockAt(next);
+        if(b == nullptr || b->timestamp > timestamp){
+            break;
+        }
+        off = next;
+    }
+    this->enterBlock(off);
+
+    // delta rows depend on the rows before them, decode the ones we skip
+    while(this->row < this->block->rows && this->rowTimes[this->row] < timestamp){
+        if(this->block->encoding == SPECTROGRAM_DELTA_VARINT){
+            this->decodeRow();
+        }else{
+            this->row++;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief SpectrogramReader::nextRow read the row at the current position and advance
+ * @param bins set to the number of values in the row
+ * @param timestamp set to the time the row was recorded, ms since epoch
+ * @return the row, valid until the next call, nullptr at the end of the recording
+ * raw rows point straight into the mapping
+ */
+const double* SpectrogramReader::nextRow(int* bins, qint64* timestamp){
+    if(this->block == nullptr){
+        return nullptr;
+    }
+    if(this->row >= this->block->rows){
+        qint64 next = this->nextBlockOffset(this->blockOffset);
+        if(this->blockAt(next) == nullptr){
+            return nullptr;
+        }
+        this->enterBlock(next);
+    }
+
+    *bins = int(this->block->bins);
+    *timestamp = this->rowTimes[this->row];
+
+    if(this->block->encoding == SPECTROGRAM_RAW_F64){
+        const double* values = (const double*)this->payload + this->row*this->block->bins;
+        this->row++;
+        return values;
+    }
+    return this->decodeRow();
+}
+
+/**
+ * @brief SpectrogramReader::decodeRow decode the next row of a delta block into the row buffer
+ * @return the row buffer
+ */
+const double* SpectrogramReader::decodeRow(){
+    const uchar* end = this->payload + this->block->payloadBytes;
+    int bins = int(this->block->bins);
+    for(int i = 0; i < bins; i++){
+        uint32_t z = decodeVarint(&this->cursor, end);
+        int32_t delta = int32_t(z >> 1) ^ -int32_t(z & 1);
+        this->levels[i] = int16_t(this->levels[i] + delta);
+        this->decoded[i] = this->levels[i]*0.01;
+    }
+    this->row++;
+    return this->decoded;
+}
+
+/**
+ * @brief SpectrogramReader::firstTimestamp
+ * @return time of the first recorded row, ms since epoch
+ */
+qint64 SpectrogramReader::firstTimestamp(){
+    return this->index.isEmpty() ? 0 : this->index.first().timestamp;
+}
+
+
+SpectrogramPlayer::SpectrogramPlayer(QObject *parent) :
+    QObject(parent)
+{
+    this->timer.setInterval(10);
+    connect(&this->timer, &QTimer::timeout, this, &SpectrogramPlayer::tick);
+}
+
+/**
+ * @brief SpectrogramPlayer::play start playback
+ * @param fromTimestamp recording time to start at, ms since epoch
+ * @param speed 1.0 plays at the recorded pace
+ */
+void SpectrogramPlayer::play(qint64 fromTimestamp, double speed){
+    this->stop();
+    if(!this->reader.seek(fromTimestamp)){
+        return;
+    }
+    this->speed = speed > 0.0 ? speed : 1.0;
+    this->pendingRow = this->reader.nextRow(&this->pendingBins, &this->pendingTime);
+    if(this->pendingRow == nullptr){
+        emit finished();
+        return;
+    }
+    this->startTime = this->pendingTime;
+    this->clock.start();
+    this->timer.start();
+}
+
+/**
+ * @brief SpectrogramPlayer::stop
+ */
+void SpectrogramPlayer::stop(){
+    this->timer.stop();
+    this->pendingRow = nullptr;
+}
+
+/**
+ * @brief SpectrogramPlayer::tick emit every row that is due
+ */
+void SpectrogramPlayer::tick(){
+    qint64 now = this->startTime + qint64(this->clock.elapsed()*this->speed);
+    if(this->pendingRow != nullptr && this->pendingTime - now > SPECTROGRAM_MAX_GAP_MS){
+        this->startTime += this->pendingTime - now; // the radio was off, skip the silence
+        now = this->pendingTime;
+    }
+
+    while(this->pendingRow != nullptr && this->pendingTime <= now){
+        emit rowReady(this->pendingRow, this->pendingBins);
+        this->pendingRow = this->reader.nextRow(&this->pendingBins, &this->pendingTime);
+    }
+
+    if(this->pendingRow == nullptr){
+        this->timer.stop();
+        emit finished();
+    }
+}
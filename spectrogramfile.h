@@ -0,0 +1,199 @@
+#ifndef SPECTROGRAMFILE_H
+#define SPECTROGRAMFILE_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QVector>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <cstdint>
+#include "sampletype.h"
+#include "fftframe.h"
+
+/*
+ * Spectrogram file layout (all fields little-endian, host order on the Pi and x86):
+ *
+ *   SpectrogramFileHeader
+ *   block 0: SpectrogramBlockHeader, rows x int64 row timestamps, payload, padding to 8 bytes
+ *   block 1: ...
+ *   index:   SpectrogramIndexHeader, count x SpectrogramIndexEntry
+ *
+ * Blocks hold up to SPECTROGRAM_ROWS_PER_BLOCK rows that share the same center
+ * frequency, bandwidth and bin count; a retune closes the current block early.
+ * The index, written on close, has one entry per SPECTROGRAM_INDEX_STRIDE blocks.
+ * A file without an index (recording was interrupted) is still readable, the
+ * reader rebuilds the index by walking the block headers.
+ */
+
+#define SPECTROGRAM_MAGIC           0x4D475053  // "SPGM"
+#define SPECTROGRAM_BLOCK_MAGIC     0x4B4C4253  // "SBLK"
+#define SPECTROGRAM_INDEX_MAGIC     0x58444953  // "SIDX"
+#define SPECTROGRAM_VERSION         1
+#define SPECTROGRAM_ROWS_PER_BLOCK  64
+#define SPECTROGRAM_INDEX_STRIDE    16
+#define SPECTROGRAM_MAX_GAP_MS      2000    // longer pauses in a recording are skipped on playback
+
+enum SpectrogramEncoding {
+    SPECTROGRAM_RAW_F64         = 0,    // rows of doubles, played back straight from the mapping
+    SPECTROGRAM_DELTA_VARINT    = 1     // centi-dB rows, delta to the previous row, zigzag varints
+};
+
+struct SpectrogramFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t encoding;
+    uint32_t rowsPerBlock;
+    uint32_t reserved;
+    int64_t  indexOffset;   // 0 if the recording was not closed cleanly
+    int64_t  reserved2;
+};
+
+struct SpectrogramBlockHeader {
+    uint32_t magic;
+    uint16_t encoding;
+    uint16_t rows;
+    uint32_t bins;
+    uint32_t payloadBytes;  // excluding padding
+    double   centerFrequency;
+    double   bandwidth;
+    int64_t  timestamp;     // ms since epoch of the first row
+    int64_t  reserved;
+};
+
+struct SpectrogramIndexHeader {
+    uint32_t magic;
+    uint32_t count;
+};
+
+struct SpectrogramIndexEntry {
+    int64_t timestamp;      // first row of the block
+    int64_t offset;         // file offset of the block header
+};
+
+/**
+ * @brief The SpectrogramWriter class records FFT frames to a spectrogram file
+ * Buffers are sized when the bin count changes, so recording a frame does not allocate.
+ * Self-describing frames are recorded with their own tuning and producer timestamp.
+ */
+class SpectrogramWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SpectrogramWriter(QObject *parent = nullptr);
+    ~SpectrogramWriter();
+    bool open(QString path, SpectrogramEncoding encoding = SPECTROGRAM_DELTA_VARINT);
+    void close();
+    bool isOpen() { return file.isOpen(); }
+
+public slots:
+    void appendFFT(const QVector<double>& fft);
+    void appendFrame(const FFTFrameRef& frame);
+    void appendRow(const double* values, int bins);
+    void setCenterFreq(double freq);
+    void setBandwidth(double bw);
+
+private:
+    void reserve(int bins);
+    void recordRow(const double* values, int bins, int64_t timestamp);
+    void flushBlock();
+    QFile file;
+    SpectrogramEncoding encoding = SPECTROGRAM_DELTA_VARINT;
+    double centerFrequency = 0.0;
+    double bandwidth = 0.0;
+    bool frameTuning = false;       // the radio's frames carry their own tuning, the GUI's is ignored
+    int bins = 0;
+    int rows = 0;                   // rows in the block being built
+    int capacity = 0;               // bins the buffers are sized for
+    QVector<double> widened;        // float and centi-dB frames converted to dB
+    int64_t times[SPECTROGRAM_ROWS_PER_BLOCK];
+    uchar* payload = nullptr;       // block payload being built
+    int payloadBytes = 0;
+    int16_t* previous = nullptr;    // previous row in centi-dB, for delta coding
+    int64_t offset = 0;             // file offset of the next block
+    int blocks = 0;
+    QVector<SpectrogramIndexEntry> index;
+};
+
+/**
+ * @brief The SpectrogramReader class reads a spectrogram file through a memory mapping
+ * Raw blocks are returned as pointers into the mapping, delta blocks are decoded
+ * into one reusable row buffer. Seeking by time is a binary search of the sparse
+ * index followed by a walk over at most SPECTROGRAM_INDEX_STRIDE block headers.
+ */
+class SpectrogramReader
+{
+public:
+    SpectrogramReader();
+    ~SpectrogramReader();
+    bool open(QString path);
+    void close();
+    bool seek(qint64 timestamp);
+    const double* nextRow(int* bins, qint64* timestamp);
+    const SpectrogramBlockHeader* currentBlock() { return block; }
+    qint64 firstTimestamp();
+    qint64 lastTimestamp() { return lastTime; }
+
+private:
+    bool loadIndex();
+    void rebuildIndex();
+    const SpectrogramBlockHeader* blockAt(qint64 offset);
+    qint64 nextBlockOffset(qint64 offset);
+    void enterBlock(qint64 offset);
+    const double* decodeRow();
+    QFile file;
+    uchar* map = nullptr;
+    qint64 size = 0;
+    QVector<SpectrogramIndexEntry> index;
+    qint64 dataEnd = 0;             // end of the block area
+    qint64 lastTime = 0;
+    qint64 blockOffset = 0;         // current block
+    const SpectrogramBlockHeader* block = nullptr;
+    const int64_t* rowTimes = nullptr;
+    const uchar* payload = nullptr;
+    const uchar* cursor = nullptr;  // next varint in a delta block
+    int row = 0;                    // next row in the current block
+    double* decoded = nullptr;
+    int16_t* levels = nullptr;      // running centi-dB values for delta blocks
+    int capacity = 0;
+};
+
+/**
+ * @brief The SpectrogramPlayer class replays a recording at its original pace
+ * rowReady hands out a pointer that is only valid until the next row is read,
+ * connect it with a direct connection.
+ */
+class SpectrogramPlayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SpectrogramPlayer(QObject *parent = nullptr);
+    bool open(QString path) { return reader.open(path); }
+    SpectrogramReader* getReader() { return &reader; }
+
+public slots:
+    void play(qint64 fromTimestamp, double speed = 1.0);
+    void stop();
+
+signals:
+    void rowReady(const double* values, int bins);
+    void finished();
+
+private slots:
+    void tick();
+
+private:
+    SpectrogramReader reader;
+    QTimer timer;
+    QElapsedTimer clock;
+    double speed = 1.0;
+    qint64 startTime = 0;           // recording time at which play() started
+    const double* pendingRow = nullptr;
+    int pendingBins = 0;
+    qint64 pendingTime = 0;
+};
+
+int encodeVarint(uint32_t value, uchar* out);
+uint32_t decodeVarint(const uchar** in, const uchar* end);
+
+#endif // SPECTROGRAMFILE_H
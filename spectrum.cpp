@@ -0,0 +1,376 @@
+#include "spectrum.h"
+
+SpectrumTrace::SpectrumTrace(){
+}
+
+SpectrumTrace::~SpectrumTrace(){
+    free(this->trace);
+    free(this->sum);
+    free(this->history);
+}
+
+/**
+ * @brief SpectrumTrace::setMode change how frames are combined, restarts the trace
+ * @param mode
+ */
+void SpectrumTrace::setMode(TraceMode mode){
+    this->mode = mode;
+    this->reset();
+}
+
+/**
+ * @brief SpectrumTrace::setFrames set the length of the N-frame average, restarts the trace
+ * @param frames
+ */
+void SpectrumTrace::setFrames(int frames){
+    this->frames = frames > 0 ? frames : 1;
+    if(this->bins > 0){
+        this->history = (double*)realloc(this->history, size_t(this->frames)*this->bins*sizeof(double));
+    }
+    this->reset();
+}
+
+/**
+ * @brief SpectrumTrace::reserve size the buffers for frames of bins values
+ * @param bins
+ */
+void SpectrumTrace::reserve(int bins){
+    this->bins = bins;
+    this->trace   = (double*)realloc(this->trace, bins*sizeof(double));
+    this->sum     = (double*)realloc(this->sum, bins*sizeof(double));
+    this->history = (double*)realloc(this->history, size_t(this->frames)*bins*sizeof(double));
+    this->reset();
+}
+
+/**
+ * @brief SpectrumTrace::resum recompute the running sum from the stored frames
+ * adding and subtracting doubles for hours drifts, this keeps the error bounded
+ */
+void SpectrumTrace::resum(){
+    double* __restrict s = this->sum;
+    memcpy(s, this->history, this->bins*sizeof(double));
+    for(int f = 1; f < this->count; f++){
+        const double* __restrict h = this->history + size_t(f)*this->bins;
+        for(int i = 0; i < this->bins; i++){
+            s[i] += h[i];
+        }
+    }
+}
+
+/**
+ * @brief SpectrumTrace::addFrame combine a new frame into the trace
+ * @param values fft values in dB
+ * @param bins number of values, a change restarts the trace
+ * each mode is a single branch-free pass over the bins so the compiler can vectorize it
+ */
+void SpectrumTrace::addFrame(const double* values, int bins){
+    if(bins <= 0){
+        return;
+    }
+    if(bins != this->bins){
+        this->reserve(bins);
+    }
+
+    double* __restrict t = this->trace;
+    const double* __restrict x = values;
+    int n = this->bins;
+
+    if(this->count == 0 || this->mode == TRACE_LIVE){
+        memcpy(t, x, n*sizeof(double));
+        if(this->mode == TRACE_MEAN){
+            memcpy(this->sum, x, n*sizeof(double));
+            memcpy(this->history, x, n*sizeof(double));
+            this->slot = 1 % this->frames;
+        }
+        this->count = 1;
+        return;
+    }
+
+    switch(this->mode){
+    case TRACE_AVERAGE: {
+        double a = this->alpha;
+        for(int i = 0; i < n; i++){
+            t[i] += a*(x[i] - t[i]);
+        }
+        break;
+    }
+    case TRACE_MEAN: {
+        double* __restrict s = this->sum;
+        double* __restrict h = this->history + size_t(this->slot)*n;
+        if(this->count < this->frames){
+            for(int i = 0; i < n; i++){
+                s[i] += x[i];
+                h[i] = x[i];
+            }
+            this->count++;
+        }else{
+            for(int i = 0; i < n; i++){
+                s[i] += x[i] - h[i];
+                h[i] = x[i];
+            }
+        }
+        this->slot = (this->slot + 1) % this->frames;
+        if(this->slot == 0){
+            this->resum();
+        }
+        double scale = 1.0/this->count;
+        for(int i = 0; i < n; i++){
+            t[i] = s[i]*scale;
+        }
+        break;
+    }
+    case TRACE_MAX_HOLD: {
+        double d = this->decay;
+        for(int i = 0; i < n; i++){
+            double held = t[i] - d;
+            t[i] = x[i] > held ? x[i] : held;
+        }
+        break;
+    }
+    case TRACE_MIN_HOLD:
+        for(int i = 0; i < n; i++){
+            t[i] = x[i] < t[i] ? x[i] : t[i];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+
+/**
+ * @brief Spectrum::Spectrum constructor
+ * @param parent used for QObject
+ * @param width width in pixels of the spectrum
+ * @param height height in pixels of the spectrum
+ * @param resampler resampler to share, typically the waterfall's, nullptr uses a private one
+ */
+Spectrum::Spectrum(QObject *parent, int width, int height, Resampler* resampler) :
+    QObject(parent)
+{
+    this->width = width;
+    this->height = height;
+    this->resampler = resampler != nullptr ? resampler : &this->ownResampler;
+
+    this->columns = (double*)malloc(this->width*sizeof(double));
+    memset(this->columns, 0, this->width*sizeof(double));
+    this->line.resize(this->width);
+
+    this->frame = QImage(this->width, this->height, QImage::Format_RGB32);
+    this->frame.fill(Qt::black);
+    this->clock.start();
+
+    this->flushTimer.setParent(this);   // follows the spectrum if it is moved to another thread
+    this->flushTimer.setSingleShot(true);
+    connect(&this->flushTimer, &QTimer::timeout, this, &Spectrum::flush);
+}
+
+Spectrum::~Spectrum(){
+    free(this->columns);
+    free(this->live);
+    delete this->persistence;
+}
+
+/**
+ * @brief Spectrum::appendFFT slot for external process to add new fft data
+ * @param fft
+ */
+void Spectrum::appendFFT(const QVector<double>& fft){
+    this->appendRow(fft.constData(), fft.size());
+}
+
+/**
+ * @brief Spectrum::appendFrame slot for frames straight from the radio, traces are kept in doubles
+ * @param frame shared with the other receivers, only read
+ */
+void Spectrum::appendFrame(const FFTFrameRef& frame){
+    int bins = frame->getBins();
+    switch(frame->getType()){
+    case SAMPLE_FLOAT:
+        this->widened.resize(bins);
+        widenSamples(frame->samples<float>(), bins, this->widened.data());
+        this->appendRow(this->widened.constData(), bins);
+        break;
+    case SAMPLE_CENTI_DB:
+        this->widened.resize(bins);
+        widenSamples(frame->samples<int16_t>(), bins, this->widened.data());
+        this->appendRow(this->widened.constData(), bins);
+        break;
+    default:
+        this->appendRow(frame->samples<double>(), bins);
+        break;
+    }
+}
+
+/**
+ * @brief Spectrum::appendRow add new fft data, redraws now if the display interval has passed, otherwise once it has
+ * @param fft fft values in dB, only read during the call
+ * @param size number of values
+ */
+void Spectrum::appendRow(const double* fft, int size){
+    this->trace.addFrame(fft, size);
+
+    if(this->persistence != nullptr && size > 0){
+        const double* values = fft;
+        if(size != this->width || !this->resampler->isFullView()){
+            this->resampler->resample(fft, size, this->live, this->width);
+            values = this->live;
+        }
+        this->persistence->addFrame(values);
+    }
+
+    qint64 elapsed = this->clock.elapsed();
+    if(elapsed >= this->frameInterval){
+        this->flushTimer.stop();
+        this->clock.restart();
+        this->render();
+    }else if(!this->flushTimer.isActive()){
+        this->flushTimer.start(int(this->frameInterval - elapsed));
+    }
+}
+
+/**
+ * @brief Spectrum::flush redraw the frames that arrived since the last redraw
+ */
+void Spectrum::flush(){
+    this->clock.restart();
+    this->render();
+}
+
+/**
+ * @brief Spectrum::setMode select the trace mode, restarts the trace
+ * @param mode a TraceMode
+ */
+void Spectrum::setMode(int mode){
+    this->trace.setMode(TraceMode(mode));
+}
+
+/**
+ * @brief Spectrum::setFFTRange set a manual vertical range, disables auto-level
+ * @param min power in dB at the bottom of the image
+ * @param max power in dB at the top of the image
+ */
+void Spectrum::setFFTRange(double min, double max){
+    this->autoLevel = false;
+    this->fftMin = min;
+    this->fftMax = max;
+    if(this->persistence != nullptr){
+        this->persistence->setRange(min, max);
+    }
+}
+
+/**
+ * @brief Spectrum::setAutoLevel enable or disable following the signal level
+ * @param enable
+ */
+void Spectrum::setAutoLevel(bool enable){
+    if(enable && !this->autoLevel){
+        this->level.reset();
+        this->level.setRange(this->fftMin, this->fftMax);
+    }
+    this->autoLevel = enable;
+}
+
+/**
+ * @brief Spectrum::setMaxFps cap how often the image is redrawn
+ * @param fps frames per second
+ */
+void Spectrum::setMaxFps(int fps){
+    this->frameInterval = fps > 0 ? 1000/fps : 0;
+}
+
+/**
+ * @brief Spectrum::setFrequencyView zoom in on part of the band
+ * @param start left edge of the view as a fraction of the band
+ * @param span width of the view as a fraction of the band, 1.0 shows the whole band
+ * a resampler shared with the waterfall already gets the view from there
+ */
+void Spectrum::setFrequencyView(double start, double span){
+    if(this->resampler == &this->ownResampler){
+        this->resampler->setView(start, span);
+    }
+}
+
+/**
+ * @brief Spectrum::setPersistence show how often each level was hit behind the trace
+ * @param enable false frees the persistence grid
+ */
+void Spectrum::setPersistence(bool enable){
+    if(enable && this->persistence == nullptr){
+        this->persistence = new Persistence(this->width, this->height);
+        this->persistence->setRange(this->fftMin, this->fftMax);
+        this->live = (double*)malloc(this->width*sizeof(double));
+    }else if(!enable && this->persistence != nullptr){
+        delete this->persistence;
+        this->persistence = nullptr;
+        free(this->live);
+        this->live = nullptr;
+    }
+}
+
+/**
+ * @brief Spectrum::setPersistenceDecay set how fast hits fade from the persistence display
+ * @param frames frames between decay passes
+ * @param shift each pass takes 1/2^shift off every cell
+ */
+void Spectrum::setPersistenceDecay(int frames, int shift){
+    if(this->persistence != nullptr){
+        this->persistence->setDecay(frames, shift);
+    }
+}
+
+/**
+ * @brief Spectrum::render reduce the trace to pixel columns, draw it and emit the image
+ */
+void Spectrum::render(){
+    int bins = this->trace.getBins();
+    if(bins <= 0){
+        return;
+    }
+
+    const double* values = this->trace.getTrace();
+    if(bins != this->width || !this->resampler->isFullView()){
+        this->resampler->resample(values, bins, this->columns, this->width);
+        values = this->columns;
+    }
+
+    if(this->autoLevel){
+        this->level.addRow(values, this->width);
+        if(this->level.update()){
+            this->fftMin = this->level.getMin();
+            this->fftMax = this->level.getMax();
+            if(this->persistence != nullptr){
+                this->persistence->setRange(this->fftMin, this->fftMax);
+            }
+        }
+    }
+
+    double span = this->fftMax > this->fftMin ? this->fftMax - this->fftMin : 1.0;
+    double scale = (this->height - 1)/span;
+    double bottom = this->height - 1;
+    QPointF* points = this->line.data();
+    for(int x = 0; x < this->width; x++){
+        double y = std::isnan(values[x]) ? bottom : bottom - (values[x] - this->fftMin)*scale;
+        points[x] = QPointF(x, y < 0.0 ? 0.0 : (y > bottom ? bottom : y));
+    }
+
+    if(this->persistence != nullptr){
+        this->persistence->render(this->frame);
+    }else{
+        this->frame.fill(Qt::black);
+    }
+    QPainter painter(&this->frame);
+
+    // a grid line every 10 dB
+    painter.setPen(QColor(60, 60, 60));
+    for(double db = std::ceil(this->fftMin/10.0)*10.0; db <= this->fftMax; db += 10.0){
+        int y = int(bottom - (db - this->fftMin)*scale);
+        painter.drawLine(0, y, this->width - 1, y);
+    }
+
+    painter.setPen(QColor(255, 220, 0));
+    painter.drawPolyline(this->line);
+    painter.end();
+
+    emit imageReady(this->frame);
+}
@@ -0,0 +1,124 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <QObject>
+#include <QImage>
+#include <QPainter>
+#include <QPolygonF>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "resample.h"
+#include "autolevel.h"
+#include "persistence.h"
+#include "fftframe.h"
+
+#define SPECTRUM_DEFAULT_FPS        20      // display rate cap, traces still update on every frame
+#define SPECTRUM_DEFAULT_FRAMES     8       // frames in the N-frame average
+#define SPECTRUM_DEFAULT_ALPHA      0.2     // weight of the newest frame in the moving average
+#define SPECTRUM_DEFAULT_DECAY      0.5     // dB per frame a held peak falls
+
+/**
+ * @brief The TraceMode enum selects how successive FFT frames are combined into the trace
+ */
+enum TraceMode {
+    TRACE_LIVE,         // newest frame only
+    TRACE_AVERAGE,      // exponential moving average
+    TRACE_MEAN,         // linear average of the last N frames
+    TRACE_MAX_HOLD,     // highest value seen, falling slowly
+    TRACE_MIN_HOLD      // lowest value seen
+};
+
+/**
+ * @brief The SpectrumTrace class combines FFT frames into a trace, in place over the bins
+ * Buffers are only reallocated when the bin count or frame count changes.
+ */
+class SpectrumTrace
+{
+public:
+    SpectrumTrace();
+    ~SpectrumTrace();
+    void setMode(TraceMode mode);
+    TraceMode getMode() { return mode; }
+    void setAlpha(double alpha) { this->alpha = alpha; }
+    void setDecay(double decay) { this->decay = decay; }
+    void setFrames(int frames);
+    void reset() { this->count = 0; this->slot = 0; }
+    void addFrame(const double* values, int bins);
+    const double* getTrace() { return trace; }
+    int getBins() { return bins; }
+
+private:
+    void reserve(int bins);
+    void resum();
+    TraceMode mode = TRACE_LIVE;
+    double alpha = SPECTRUM_DEFAULT_ALPHA;
+    double decay = SPECTRUM_DEFAULT_DECAY;
+    int frames = SPECTRUM_DEFAULT_FRAMES;
+    int bins = 0;
+    int count = 0;              // frames combined so far, 0 seeds the trace with the next frame
+    int slot = 0;               // oldest frame in history for the N-frame average
+    double* trace = nullptr;
+    double* sum = nullptr;      // running sum for the N-frame average
+    double* history = nullptr;  // last frames x bins values for the N-frame average
+};
+
+/**
+ * @brief The Spectrum class draws the trace as a spectrum line
+ * Traces are updated on every frame, the image is only redrawn at the capped display rate,
+ * frames skipped that way are drawn when the interval is up even if no other frame follows.
+ * With persistence on, every frame is also counted into a density display drawn behind the trace.
+ */
+class Spectrum : public QObject
+{
+    Q_OBJECT
+public:
+    Spectrum(QObject *parent = nullptr, int width = 450, int height = 200, Resampler* resampler = nullptr);
+    ~Spectrum();
+    SpectrumTrace* getTrace() { return &trace; }
+    double getFFTMin() { return fftMin; }
+    double getFFTMax() { return fftMax; }
+
+public slots:
+    void appendFFT(const QVector<double>& fft);
+    void appendFrame(const FFTFrameRef& frame);
+    void appendRow(const double* fft, int size);
+    void setMode(int mode);
+    void setFFTRange(double min, double max);
+    void setAutoLevel(bool enable);
+    void setMaxFps(int fps);
+    void setFrequencyView(double start, double span);
+    void setPersistence(bool enable);
+    void setPersistenceDecay(int frames, int shift);
+
+signals:
+    void imageReady(const QImage& image);
+
+private slots:
+    void flush();
+
+private:
+    void render();
+    int width;
+    int height;
+    double fftMin = -50.0;
+    double fftMax = 50.0;
+    bool autoLevel = true;
+    AutoLevel level;
+    SpectrumTrace trace;
+    Resampler ownResampler;
+    Resampler* resampler;       // may be shared with the waterfall so the tables are built once
+    double* columns;            // trace reduced to one value per pixel column
+    QPolygonF line;             // reused every frame, one point per column
+    QVector<double> widened;    // float and centi-dB frames converted to dB
+    Persistence* persistence = nullptr;
+    double* live = nullptr;     // newest frame reduced to pixel columns, for the persistence display
+    QImage frame;
+    QElapsedTimer clock;        // time since the last redraw
+    QTimer flushTimer;          // draws frames that arrived too soon after a redraw once the interval is up
+    qint64 frameInterval = 1000/SPECTRUM_DEFAULT_FPS;
+};
+
+#endif // SPECTRUM_H
@@ -0,0 +1,188 @@
+/*
+ * Allocation and copy count of the FFT payload path, against tools/amqp_broker.py.
+ * The client consumes radio_data like Radio::run and hands every FFT frame on the
+ * way the radio thread does, holding it until the next one as a receiver would:
+ *   after   (default) the body allocator assembles each body straight into a frame
+ *           from an FFTFramePool, as Radio::allocateBody does
+ *   before  (-DBENCH_BEFORE) the message keeps its own copy of the body, which is
+ *           then copied into a vector of doubles, as Radio::populateFFT did
+ * malloc, calloc and realloc are counted by wrapping them, memcpy by linking with
+ * --wrap=memcpy. Copies of at least BENCH_BULK_BYTES are counted as body copies.
+ * The first BENCH_WARMUP frames are not counted, so pools and buffers have settled.
+ *
+ * The after build links the tree's amqpcpp and fftframe.cpp, which needs QtCore.
+ * The before build links amqpcpp as it was before the pooled frames, with the
+ * body copied into every message. Build from the repository root:
+ *   cmake -S amqpcpp -B amqp_build -DENABLE_SSL_SUPPORT=OFF && cmake --build amqp_build
+ *   g++ -O2 -std=c++11 -fPIC -I. -Iamqpcpp/include -Iamqpcpp/rabbitmq-c/librabbitmq $(pkg-config --cflags Qt5Core) \
+ *       tools/alloc_bench.cpp fftframe.cpp sampletype.cpp amqpcpp/src/*.cpp \
+ *       amqp_build/rabbitmq-c/librabbitmq/librabbitmq.a $(pkg-config --libs Qt5Core) -lpthread -Wl,--wrap=memcpy -o alloc_after
+ *   mkdir -p old && git archive 69fd953~1 amqpcpp | tar -x -C old
+ *   g++ -O2 -std=c++11 -DBENCH_BEFORE -I. -Iold/amqpcpp/include -Iamqpcpp/rabbitmq-c/librabbitmq \
+ *       tools/alloc_bench.cpp sampletype.cpp old/amqpcpp/src/*.cpp \
+ *       amqp_build/rabbitmq-c/librabbitmq/librabbitmq.a -lpthread -Wl,--wrap=memcpy -o alloc_before
+ * Run, with a fresh broker for every run:
+ *   tools/amqp_broker.py 5673 3000 8192 & ./alloc_before 5673 3000
+ *   tools/amqp_broker.py 5673 3000 8192 & ./alloc_after 5673 3000
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <functional>
+#include <poll.h>
+#include "AMQPcpp.h"
+#include "sampletype.h"
+#ifndef BENCH_BEFORE
+#include "fftframe.h"
+#endif
+
+#define BENCH_WARMUP        200     // frames before counting starts
+#define BENCH_BULK_BYTES    1024    // smallest copy counted as a body copy
+#define BENCH_PREFETCH      64      // RADIO_PREFETCH
+
+static std::atomic<long> allocations(0);
+static std::atomic<long> copies(0);
+static std::atomic<long> copiedBytes(0);
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __real_memcpy(void* dest, const void* src, size_t n);
+
+void* malloc(size_t size){
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size){
+    allocations++;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size){
+    allocations++;
+    return __libc_realloc(p, size);
+}
+
+void* __wrap_memcpy(void* dest, const void* src, size_t n){
+    if(n >= BENCH_BULK_BYTES){
+        copies++;
+        copiedBytes += n;
+    }
+    return __real_memcpy(dest, src, n);
+}
+}
+
+int main(int argc, char** argv){
+    if(argc < 3 || atoi(argv[2]) <= BENCH_WARMUP){
+        fprintf(stderr, "usage: %s PORT MESSAGES, more than %d messages\n", argv[0], BENCH_WARMUP);
+        return 1;
+    }
+    int messages = atoi(argv[2]);
+
+    try{
+        AMQP amqp(std::string("localhost:") + argv[1]);
+        AMQPQueue* q = amqp.createQueue("radio_data");
+        q->Declare();
+        q->Bind("amq.fanout", "hello");
+        q->setConsumerTag("tag_sdr_gui");
+        q->Qos(0, BENCH_PREFETCH, 0);
+        q->StartConsume(0);
+        q->setParam(AMQP_MULTIPLE);
+
+#ifdef BENCH_BEFORE
+        std::vector<double> fft;
+        const char* name = "before";
+#else
+        FFTFramePool* pool = new FFTFramePool();
+        FFTFrameRef pending;
+        FFTFrameRef held;      // the receiver's reference, dropped when the next frame comes
+        std::function<char*(AMQPMessage*, size_t)> allocator = [&](AMQPMessage* m, size_t size) -> char* {
+            pending.reset();
+            const std::string* contentType = m->findHeader("Content-type");
+            SampleType type = SAMPLE_DOUBLE;
+            if(contentType == nullptr || !sampleTypeFromContentType(contentType->c_str(), &type)){
+                return nullptr;
+            }
+            pending = pool->acquire(type, size);
+            return pending.isNull() ? nullptr : pending->data();
+        };
+        q->setBodyAllocator(allocator);
+        const char* name = "after";
+#endif
+
+        struct timeval noWait = { 0, 0 };
+        int got = 0;
+        long allocations0 = 0;
+        long copies0 = 0;
+        long copiedBytes0 = 0;
+        double sum = 0.0;
+        while(got < messages){
+            struct pollfd fd;
+            fd.fd = q->getSocket();
+            fd.events = POLLIN;
+            fd.revents = 0;
+            poll(&fd, 1, -1);
+            uint32_t lastTag = 0;
+            while(got < messages && q->NextDelivery(&noWait)){
+                AMQPMessage* m = q->getMessage();
+                lastTag = m->getDeliveryTag();
+#ifdef BENCH_BEFORE
+                std::string contentType = m->getHeader("Content-type");
+                SampleType type = SAMPLE_DOUBLE;
+                if(sampleTypeFromContentType(contentType.c_str(), &type)){
+                    uint32_t len = 0;
+                    char* data = m->getMessage(&len);
+                    fft.resize(len/sizeof(double));
+                    memcpy(fft.data(), data, len);
+                    sum += fft[0];
+                }
+#else
+                held = pending;
+                pending.reset();
+                if(!held.isNull()){
+                    sum += held->samples<double>()[0];
+                }
+#endif
+                if(++got == BENCH_WARMUP){
+                    allocations0 = allocations;
+                    copies0 = copies;
+                    copiedBytes0 = copiedBytes;
+                }
+            }
+            if(lastTag != 0){
+                q->Ack(lastTag);
+            }
+        }
+
+        double frames = got - BENCH_WARMUP;
+        printf("%-6s %.0f frames: %.2f allocations, %.2f body copies, %.0f bytes copied per frame  (%g)\n",
+               name, frames, (allocations - allocations0)/frames, (copies - copies0)/frames,
+               (copiedBytes - copiedBytes0)/frames, sum);
+#ifndef BENCH_BEFORE
+        held.reset();
+        printf("%-6s pool frames %d, buffer allocations %llu\n",
+               name, pool->getFrames(), (unsigned long long)pool->getAllocations());
+        pool->close();
+#endif
+    }catch(AMQPException e){
+        fprintf(stderr, "%s\n", e.getMessage().c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// amqpcpp refers to the rabbitmq-c SSL socket, which ENABLE_SSL_SUPPORT=OFF leaves out
+extern "C" {
+amqp_socket_t* amqp_ssl_socket_new(amqp_connection_state_t){ return NULL; }
+int amqp_ssl_socket_set_cacert(amqp_socket_t*, const char*){ return -1; }
+int amqp_ssl_socket_set_key(amqp_socket_t*, const char*, const char*){ return -1; }
+void amqp_ssl_socket_set_verify_peer(amqp_socket_t*, amqp_boolean_t){}
+void amqp_ssl_socket_set_verify_hostname(amqp_socket_t*, amqp_boolean_t){}
+void amqp_ssl_socket_set_verify(amqp_socket_t*, amqp_boolean_t){}
+}
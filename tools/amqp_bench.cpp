@@ -0,0 +1,276 @@
+/*
+ * Benchmark of the radio_data receive loop against tools/amqp_broker.py, no Qt needed.
+ * The client declares and binds radio_data like Radio does and receives MESSAGES
+ * messages with one of the loops Radio::run has used:
+ *   get               basic.get and a 1 ms sleep per message, the old loop
+ *   consume PREFETCH  basic.consume with a prefetch window, poll() on the socket,
+ *                     drain every delivery that arrived, one multiple ack per wakeup
+ *   batch PREFETCH BATCH MS
+ *                     the loop Radio::run has now, a multiple ack once BATCH deliveries
+ *                     are unacked or the oldest has waited MS, like Radio::setAckPolicy
+ *   stall PREFETCH BATCH MS
+ *                     the same with the consumers reported stalled for BENCH_STALL_S
+ *                     once BENCH_STALL_AFTER messages are in, acks are held meanwhile
+ * and prints messages per second, wakeups, acks and the CPU time it used. The get
+ * loop also prints what one second of polling an empty queue costs, the stall mode
+ * how many deliveries still arrived during the stall.
+ *
+ * The vendored amqpcpp is built without SSL, the stubs at the bottom satisfy the
+ * linker. Build from the repository root:
+ *   cmake -S amqpcpp -B amqp_build -DENABLE_SSL_SUPPORT=OFF && cmake --build amqp_build
+ *   g++ -O2 -std=c++11 -Iamqpcpp/include -Iamqpcpp/rabbitmq-c/librabbitmq tools/amqp_bench.cpp \
+ *       amqp_build/libamqpcpp-static.a amqp_build/rabbitmq-c/librabbitmq/librabbitmq.a -o amqp_bench
+ * Run, with a fresh broker for every run:
+ *   tools/amqp_broker.py 5673 2000 8192 & ./amqp_bench 5673 2000 get
+ *   tools/amqp_broker.py 5673 2000 8192 & ./amqp_bench 5673 2000 consume 64
+ *   tools/amqp_broker.py 5673 20000 1856 & ./amqp_bench 5673 20000 batch 64 16 50
+ * tools/amqp_sweep.sh runs the prefetch and ack batching settings one after another.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "AMQPcpp.h"
+
+#define BENCH_PREFETCH  64          // RADIO_PREFETCH
+#define BENCH_IDLE_S    1.0         // length of the idle get loop measurement
+#define BENCH_BATCH     16          // RADIO_ACK_BATCH
+#define BENCH_ACK_MS    50          // RADIO_ACK_MS
+#define BENCH_STALL_AFTER   1000    // messages received before the simulated stall
+#define BENCH_STALL_S   1.0         // length of the simulated stall
+#define BENCH_HOLD_POLL_MS  100     // FRAME_QUEUE_BLOCK_POLL_MS, the recheck floor while acks are held
+
+/**
+ * @brief now time in seconds
+ */
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief cpuTime user plus system time of this process in seconds
+ */
+static double cpuTime(){
+    struct rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    return r.ru_utime.tv_sec + r.ru_stime.tv_sec + (r.ru_utime.tv_usec + r.ru_stime.tv_usec)/1e6;
+}
+
+/**
+ * @brief runGet the old loop, one basic.get round trip then a 1 ms sleep
+ */
+static int runGet(AMQPQueue* q, int messages, long* wakeups){
+    int got = 0;
+    while(got < messages){
+        q->Get(AMQP_NOACK);
+        AMQPMessage* m = q->getMessage();
+        (*wakeups)++;
+        if(m != NULL && m->getMessageCount() > -1){
+            uint32_t len = 0;
+            m->getMessage(&len);
+            got++;
+        }
+        usleep(1000);
+    }
+    return got;
+}
+
+/**
+ * @brief runConsume the current loop without the ack batching, block in poll and drain what arrived
+ */
+static int runConsume(AMQPQueue* q, int messages, int prefetch, long* wakeups, long* acks){
+    q->Qos(0, uint16_t(prefetch), 0);
+    q->StartConsume(0);
+    q->setParam(AMQP_MULTIPLE);
+    struct timeval noWait = { 0, 0 };
+    int got = 0;
+    while(got < messages){
+        struct pollfd fd;
+        fd.fd = q->getSocket();
+        fd.events = POLLIN;
+        fd.revents = 0;
+        poll(&fd, 1, -1);
+        (*wakeups)++;
+        uint32_t lastTag = 0;
+        while(got < messages && q->NextDelivery(&noWait)){
+            uint32_t len = 0;
+            q->getMessage()->getMessage(&len);
+            lastTag = q->getMessage()->getDeliveryTag();
+            got++;
+        }
+        if(lastTag != 0){
+            q->Ack(lastTag);
+            (*acks)++;
+        }
+    }
+    return got;
+}
+
+/**
+ * @brief The Stall struct simulates a consumer that stops draining its frame queue
+ */
+typedef struct {
+    bool enabled;
+    double start;       // when the stall began, 0 before it
+    long holds;         // times acks were held
+    long delivered;     // deliveries that still arrived during the stall
+} Stall;
+
+/**
+ * @brief stalled what Radio::consumersStalled would say after got messages
+ */
+static bool stalled(Stall* stall, int got){
+    if(!stall->enabled || got < BENCH_STALL_AFTER){
+        return false;
+    }
+    if(stall->start == 0.0){
+        stall->start = now();
+    }
+    return now() - stall->start < BENCH_STALL_S;
+}
+
+/**
+ * @brief runBatch the loop in Radio::run, acks batched by count and age and held while stalled
+ */
+static int runBatch(AMQPQueue* q, int messages, int prefetch, int batch, int intervalMs,
+                    Stall* stall, long* wakeups, long* acks){
+    q->Qos(0, uint16_t(prefetch), 0);
+    q->StartConsume(0);
+    q->setParam(AMQP_MULTIPLE);
+    struct timeval noWait = { 0, 0 };
+    uint32_t lastTag = 0;
+    int unacked = 0;
+    double oldest = 0.0;
+    bool holding = false;
+    int got = 0;
+    while(got < messages){
+        int timeout = -1;
+        if(unacked > 0){
+            timeout = holding ? std::max(intervalMs, BENCH_HOLD_POLL_MS)
+                              : std::max(0, int(intervalMs - (now() - oldest)*1000.0));
+        }
+        struct pollfd fd;
+        fd.fd = q->getSocket();
+        fd.events = POLLIN;
+        fd.revents = 0;
+        poll(&fd, 1, timeout);
+        (*wakeups)++;
+        while(got < messages && q->NextDelivery(&noWait)){
+            uint32_t len = 0;
+            q->getMessage()->getMessage(&len);
+            lastTag = q->getMessage()->getDeliveryTag();
+            got++;
+            if(stall->start != 0.0 && now() - stall->start < BENCH_STALL_S){
+                stall->delivered++;
+            }
+            if(unacked++ == 0){
+                oldest = now();
+            }
+            if(unacked >= batch && !stalled(stall, got)){
+                q->Ack(lastTag);
+                (*acks)++;
+                unacked = 0;
+            }
+        }
+        if(unacked > 0 && (unacked >= batch || (now() - oldest)*1000.0 >= intervalMs)){
+            bool s = stalled(stall, got);
+            if(s && !holding){
+                stall->holds++;
+            }
+            holding = s;
+            if(!holding){
+                q->Ack(lastTag);
+                (*acks)++;
+                unacked = 0;
+            }
+        }
+    }
+    return got;
+}
+
+int main(int argc, char** argv){
+    const char* usage = "usage: %s PORT MESSAGES get | consume [PREFETCH] | batch|stall [PREFETCH [BATCH [MS]]]\n";
+    if(argc < 4){
+        fprintf(stderr, usage, argv[0]);
+        return 1;
+    }
+    int messages = atoi(argv[2]);
+    std::string mode = argv[3];
+    int prefetch = argc > 4 ? atoi(argv[4]) : BENCH_PREFETCH;
+    int batch = argc > 5 ? atoi(argv[5]) : BENCH_BATCH;
+    int intervalMs = argc > 6 ? atoi(argv[6]) : BENCH_ACK_MS;
+    bool batched = mode == "batch" || mode == "stall";
+    if(messages <= 0 || prefetch <= 0 || prefetch > 65535 || batch <= 0 || intervalMs < 0
+            || (mode != "get" && mode != "consume" && !batched)){
+        fprintf(stderr, usage, argv[0]);
+        return 1;
+    }
+    // clamped like Radio::setAckPolicy, a full window waiting for an ack would stall the broker
+    batch = std::min(batch, std::max(1, prefetch/2));
+    Stall stall = { mode == "stall", 0.0, 0, 0 };
+
+    try{
+        AMQP amqp(std::string("localhost:") + argv[1]);
+        AMQPQueue* q = amqp.createQueue("radio_data");
+        q->Declare();
+        q->Bind("amq.fanout", "hello");
+        q->setConsumerTag("tag_sdr_gui");
+
+        long wakeups = 0;
+        long acks = 0;
+        double cpu = cpuTime();
+        double start = now();
+        int got = 0;
+        if(mode == "get"){
+            got = runGet(q, messages, &wakeups);
+        }else if(mode == "consume"){
+            got = runConsume(q, messages, prefetch, &wakeups, &acks);
+        }else{
+            got = runBatch(q, messages, prefetch, batch, intervalMs, &stall, &wakeups, &acks);
+        }
+        double seconds = now() - start;
+        cpu = cpuTime() - cpu;
+
+        std::string name = mode == "get" ? mode : mode + " " + std::to_string(prefetch);
+        if(batched){
+            name += " " + std::to_string(batch) + " " + std::to_string(intervalMs);
+        }
+        printf("%-18s %d msgs %7.3f s %8.0f msg/s %6ld wakeups %6ld acks  cpu %.3f s\n",
+               name.c_str(), got, seconds, got/seconds, wakeups, acks, cpu);
+        if(mode == "stall"){
+            printf("%-18s %ld holds, %ld delivered during the %.1f s stall\n",
+                   name.c_str(), stall.holds, stall.delivered, BENCH_STALL_S);
+        }
+
+        if(mode == "get"){
+            // the broker has nothing left, this is what the old loop cost while idle
+            cpu = cpuTime();
+            start = now();
+            while(now() - start < BENCH_IDLE_S){
+                q->Get(AMQP_NOACK);
+                usleep(1000);
+            }
+            printf("%-18s idle cpu %.3f s per s\n", name.c_str(), (cpuTime() - cpu)/(now() - start));
+        }
+    }catch(AMQPException e){
+        fprintf(stderr, "%s\n", e.getMessage().c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// amqpcpp refers to the rabbitmq-c SSL socket, which ENABLE_SSL_SUPPORT=OFF leaves out
+extern "C" {
+amqp_socket_t* amqp_ssl_socket_new(amqp_connection_state_t){ return NULL; }
+int amqp_ssl_socket_set_cacert(amqp_socket_t*, const char*){ return -1; }
+int amqp_ssl_socket_set_key(amqp_socket_t*, const char*, const char*){ return -1; }
+void amqp_ssl_socket_set_verify_peer(amqp_socket_t*, amqp_boolean_t){}
+void amqp_ssl_socket_set_verify_hostname(amqp_socket_t*, amqp_boolean_t){}
+void amqp_ssl_socket_set_verify(amqp_socket_t*, amqp_boolean_t){}
+}
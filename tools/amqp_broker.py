@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+
+"""
+Stand-in AMQP 0-9-1 broker for benchmarking the radio_data consumer without
+RabbitMQ. It speaks just enough of the protocol for amqpcpp: connection and
+channel setup, exchange and queue declare/bind, basic.qos, basic.consume,
+basic.get and basic.ack. One client, no authentication, no persistence.
+
+    tools/amqp_broker.py PORT MESSAGES BODY_BYTES
+
+Every message is an application/octet-stream body of BODY_BYTES zero bytes.
+basic.get hands out one message per call. After basic.consume a pump thread
+delivers the messages as fast as the socket takes them, keeping no more than
+the basic.qos prefetch count unacked, so a client that holds its acks stops
+the flow like RabbitMQ would. The broker exits when the client closes the
+connection.
+"""
+
+import socket
+import struct
+import sys
+import threading
+
+FRAME_METHOD = 1
+FRAME_HEADER = 2
+FRAME_BODY = 3
+FRAME_END = b'\xce'
+FRAME_MAX = 131072
+CHANNEL_MAX = 2047
+CONTENT_TYPE = b'application/octet-stream'
+EXCHANGE = b'amq.fanout'
+ROUTING_KEY = b'hello'
+QUEUE = b'radio_data'
+
+
+def short_str(s):
+    return struct.pack('B', len(s)) + s
+
+
+def long_str(s):
+    return struct.pack('>I', len(s)) + s
+
+
+def frame(kind, channel, payload):
+    return struct.pack('>BHI', kind, channel, len(payload)) + payload + FRAME_END
+
+
+def method(channel, cls, meth, args=b''):
+    return frame(FRAME_METHOD, channel, struct.pack('>HH', cls, meth) + args)
+
+
+def recv_exact(sock, n):
+    data = b''
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+
+class Broker:
+    def __init__(self, sock, messages, body):
+        self.sock = sock
+        self.messages = messages
+        self.body = body
+        self.sent = 0
+        self.acked = 0
+        self.prefetch = 0
+        self.sendLock = threading.Lock()
+        self.window = threading.Condition()
+
+    def send(self, data):
+        with self.sendLock:
+            self.sock.sendall(data)
+
+    def content(self, channel):
+        # basic class header, only the content-type property set
+        props = struct.pack('>H', 0x8000) + short_str(CONTENT_TYPE)
+        header = frame(FRAME_HEADER, channel, struct.pack('>HHQ', 60, 0, len(self.body)) + props)
+        return header + frame(FRAME_BODY, channel, self.body)
+
+    def pump(self, channel, tag):
+        """basic.deliver every message, holding back while prefetch are unacked."""
+        while self.sent < self.messages:
+            with self.window:
+                while self.prefetch and self.sent - self.acked >= self.prefetch:
+                    self.window.wait()
+                self.sent += 1
+                deliveryTag = self.sent
+            args = short_str(tag) + struct.pack('>QB', deliveryTag, 0) + short_str(EXCHANGE) + short_str(ROUTING_KEY)
+            self.send(method(channel, 60, 60, args) + self.content(channel))
+
+    def get(self, channel):
+        with self.window:
+            if self.sent >= self.messages:
+                self.send(method(channel, 60, 72, short_str(b'')))
+                return
+            self.sent += 1
+            deliveryTag = self.sent
+        args = struct.pack('>QB', deliveryTag, 0) + short_str(EXCHANGE) + short_str(ROUTING_KEY)
+        args += struct.pack('>I', self.messages - deliveryTag)
+        self.send(method(channel, 60, 71, args) + self.content(channel))
+
+    def serve(self):
+        recv_exact(self.sock, 8)    # protocol header
+        self.send(method(0, 10, 10, b'\x00\x09' + struct.pack('>I', 0) + long_str(b'PLAIN') + long_str(b'en_US')))
+        while True:
+            try:
+                kind, channel, size = struct.unpack('>BHI', recv_exact(self.sock, 7))
+                payload = recv_exact(self.sock, size + 1)[:-1]
+            except EOFError:
+                return
+            if kind != FRAME_METHOD:
+                continue
+            cls, meth = struct.unpack('>HH', payload[:4])
+            args = payload[4:]
+            if (cls, meth) == (10, 11):     # connection.start-ok
+                self.send(method(0, 10, 30, struct.pack('>HIH', CHANNEL_MAX, FRAME_MAX, 0)))
+            elif (cls, meth) == (10, 40):   # connection.open
+                self.send(method(0, 10, 41, short_str(b'')))
+            elif (cls, meth) == (10, 50):   # connection.close
+                self.send(method(0, 10, 51))
+                return
+            elif (cls, meth) == (20, 10):   # channel.open
+                self.send(method(channel, 20, 11, long_str(b'')))
+            elif (cls, meth) == (20, 40):   # channel.close
+                self.send(method(channel, 20, 41))
+            elif (cls, meth) == (40, 10):   # exchange.declare
+                self.send(method(channel, 40, 11))
+            elif (cls, meth) == (50, 10):   # queue.declare
+                self.send(method(channel, 50, 11, short_str(QUEUE) + struct.pack('>II', 0, 0)))
+            elif (cls, meth) == (50, 20):   # queue.bind
+                self.send(method(channel, 50, 21))
+            elif (cls, meth) == (60, 10):   # basic.qos, prefetch-size then prefetch-count
+                with self.window:
+                    self.prefetch = struct.unpack('>H', args[4:6])[0]
+                    self.window.notify_all()
+                self.send(method(channel, 60, 11))
+            elif (cls, meth) == (60, 20):   # basic.consume, reserved, queue, consumer tag
+                queueLen = args[2]
+                tagLen = args[3 + queueLen]
+                tag = args[4 + queueLen:4 + queueLen + tagLen] or b'ctag'
+                self.send(method(channel, 60, 21, short_str(tag)))
+                threading.Thread(target=self.pump, args=(channel, tag), daemon=True).start()
+            elif (cls, meth) == (60, 70):   # basic.get
+                self.get(channel)
+            elif (cls, meth) == (60, 80):   # basic.ack, acks with the multiple flag cover every tag up to this one
+                deliveryTag, = struct.unpack('>Q', args[:8])
+                with self.window:
+                    self.acked = max(self.acked, deliveryTag)
+                    self.window.notify_all()
+
+
+def main():
+    if len(sys.argv) != 4:
+        raise SystemExit("usage: amqp_broker.py PORT MESSAGES BODY_BYTES")
+    port = int(sys.argv[1])
+    messages = int(sys.argv[2])
+    body = b'\0'*int(sys.argv[3])
+
+    server = socket.socket()
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(('127.0.0.1', port))
+    server.listen(1)
+    sock, _ = server.accept()
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    Broker(sock, messages, body).serve()
+    sock.close()
+    server.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Runs amqp_bench against a fresh amqp_broker.py for each receive loop and
+# prefetch/ack batching setting. Run from the repository root after building
+# amqp_bench (see tools/README.md):
+#   tools/amqp_sweep.sh [MESSAGES] [BODY_BYTES] [PORT]
+
+MESSAGES=${1:-20000}
+BODY_BYTES=${2:-1856}
+PORT=${3:-5673}
+BENCH=${AMQP_BENCH:-./amqp_bench}
+
+run() {
+    python3 tools/amqp_broker.py "$PORT" "$MESSAGES" "$BODY_BYTES" &
+    BROKER=$!
+    sleep 0.5
+    "$BENCH" "$PORT" "$MESSAGES" "$@"
+    wait $BROKER
+}
+
+run get
+run consume 64          # ack per wakeup
+run batch 64 1 0        # ack every message
+run batch 64 16 50      # RADIO_PREFETCH, RADIO_ACK_BATCH, RADIO_ACK_MS defaults
+run batch 64 32 50
+run batch 256 64 50
+run stall 64 16 50      # consumers stalled for 1 s, acks held
@@ -0,0 +1,189 @@
+/*
+ * Microbenchmark of the waterfall row colorizer, no Qt needed.
+ * Compares the old per-pixel path (a 10,001 entry Pixel LUT indexed once per
+ * pixel) with the whole-row kernels in colorize.cpp, on the same rows.
+ *
+ * Build from the repository root, add -march=native or -mavx2 to get the AVX2 kernel:
+ *   g++ -O2 -std=c++11 -I. tools/colorize_bench.cpp colorize.cpp colormaps.cpp -o colorize_bench
+ * Run:
+ *   ./colorize_bench [WIDTH] [ROWS]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "colorize.h"
+#include "colormaps.h"
+
+#define BENCH_WIDTH     480         // pixels per row
+#define BENCH_ROWS      100000      // rows colorized per kernel
+#define BENCH_RING      64          // distinct input rows, cycled through
+#define BENCH_MIN_DB    -50.0
+#define BENCH_MAX_DB    50.0
+#define OLD_RESOLUTION  100.0       // steps per dB of the old LUT
+
+/**
+ * @brief The OldPixel struct is one entry of the old power-to-pixel LUT, blue green red alpha
+ */
+typedef struct {
+    unsigned char blue;
+    unsigned char green;
+    unsigned char red;
+    unsigned char alpha;
+} OldPixel;
+
+static int nconstrain(int n, int min, int max){
+    return (n < min ? min : (n > max ? max : n));
+}
+
+static double constrain(double x, double min, double max){
+    return (x < min ? min : (x > max ? max : x));
+}
+
+static double map(double x, double in_min, double in_max, double out_min, double out_max){
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/**
+ * @brief The OldColorizer class is the per-pixel path Waterfall used before the row kernels
+ */
+class OldColorizer
+{
+public:
+    OldColorizer(double fftMin, double fftMax){
+        this->fftMin = fftMin;
+        this->fftMax = fftMax;
+        double fftHalf = (fftMin + fftMax)/2.0;
+        this->lutSize = int((fftMax - fftMin)*OLD_RESOLUTION) + 1;
+        this->lut = (OldPixel*)malloc(this->lutSize*sizeof(OldPixel));
+        double pwr = fftMin;
+        for(int i = 0; i < this->lutSize; i++){
+            double blue = constrain(fftHalf - pwr, 0.0, fftHalf - fftMin);
+            double green = constrain(fftHalf - fabs(fftHalf - pwr), 0.0, fftHalf - fabs(fftHalf));
+            double red = constrain(pwr - fftHalf, 0.0, fftMax - fftHalf);
+            this->lut[i].blue = (unsigned char)(map(blue, 0.0, fftHalf - fftMin, 0.0, 255.0) + 0.5);
+            this->lut[i].green = (unsigned char)(map(green, 0.0, fftHalf - fabs(fftHalf), 0.0, 255.0) + 0.5);
+            this->lut[i].red = (unsigned char)(map(red, 0.0, fftMax - fftHalf, 0.0, 255.0) + 0.5);
+            this->lut[i].alpha = 0;
+            pwr += 1.0/OLD_RESOLUTION;
+        }
+    }
+    ~OldColorizer(){
+        free(this->lut);
+    }
+    void addRow(const double* values, int n, unsigned char* pixels){
+        for(int i = 0; i < n; i++){
+            this->doubleToPixel(values[i], pixels + 4*i);
+        }
+    }
+
+private:
+    void doubleToPixel(double value, unsigned char* pixData){
+        int ind = nconstrain(int(0.5 + (value - this->fftMin)*OLD_RESOLUTION), 0, this->lutSize - 1);
+        pixData[0] = this->lut[ind].blue;
+        pixData[1] = this->lut[ind].green;
+        pixData[2] = this->lut[ind].red;
+        pixData[3] = this->lut[ind].alpha;
+    }
+    double fftMin;
+    double fftMax;
+    int lutSize;
+    OldPixel* lut;
+};
+
+/**
+ * @brief now time in seconds
+ */
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief report print one kernel's rate and fold its output into a checksum so it isn't optimized out
+ */
+static void report(const char* name, double seconds, int width, int rows, const uint32_t* out){
+    uint32_t sum = 0;
+    for(int i = 0; i < width; i++){
+        sum = sum*31 + out[i];
+    }
+    double pixels = double(width)*rows;
+    printf("%-28s %8.2f ns/pixel %8.1f Mpixel/s %8.2f us/row  (%08x)\n",
+           name, seconds*1e9/pixels, pixels/seconds/1e6, seconds*1e6/rows, sum);
+}
+
+int main(int argc, char** argv){
+    int width = argc > 1 ? atoi(argv[1]) : BENCH_WIDTH;
+    int rows = argc > 2 ? atoi(argv[2]) : BENCH_ROWS;
+    if(width <= 0 || rows <= 0){
+        fprintf(stderr, "usage: %s [WIDTH] [ROWS]\n", argv[0]);
+        return 1;
+    }
+
+#if defined(COLORIZE_AVX2)
+    printf("kernel: AVX2\n");
+#elif defined(COLORIZE_SSE2)
+    printf("kernel: SSE2\n");
+#elif defined(COLORIZE_NEON)
+    printf("kernel: NEON\n");
+#else
+    printf("kernel: scalar\n");
+#endif
+
+    // noise with a few carriers, spilling over both ends of the range
+    double* input = (double*)malloc(size_t(BENCH_RING)*width*sizeof(double));
+    srand(1);
+    for(int i = 0; i < BENCH_RING*width; i++){
+        double noise = -45.0 + 10.0*rand()/RAND_MAX;
+        input[i] = (i % width) % 97 == 0 ? 55.0 : noise;
+    }
+    uint32_t* out = (uint32_t*)malloc(width*sizeof(uint32_t));
+    uint32_t* check = (uint32_t*)malloc(width*sizeof(uint32_t));
+    uint8_t* indices = (uint8_t*)malloc(width);
+    const uint32_t* lut = colormap32(COLORMAP_CLASSIC);
+
+    // the SIMD kernel has to agree with the scalar reference
+    int mismatches = 0;
+    for(int r = 0; r < BENCH_RING; r++){
+        const double* row = input + size_t(r)*width;
+        colorizeRowScalar(row, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, check);
+        colorizeRow(row, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, out);
+        for(int i = 0; i < width; i++){
+            mismatches += out[i] != check[i];
+        }
+    }
+    printf("%d x %d rows, SIMD vs scalar mismatches: %d\n", width, rows, mismatches);
+
+    OldColorizer old(BENCH_MIN_DB, BENCH_MAX_DB);
+    double start = now();
+    for(int r = 0; r < rows; r++){
+        old.addRow(input + size_t(r % BENCH_RING)*width, width, (unsigned char*)out);
+    }
+    report("old per-pixel (40 kB LUT)", now() - start, width, rows, out);
+
+    start = now();
+    for(int r = 0; r < rows; r++){
+        colorizeRowScalar(input + size_t(r % BENCH_RING)*width, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, out);
+    }
+    report("colorizeRowScalar", now() - start, width, rows, out);
+
+    start = now();
+    for(int r = 0; r < rows; r++){
+        colorizeRow(input + size_t(r % BENCH_RING)*width, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, out);
+    }
+    report("colorizeRow", now() - start, width, rows, out);
+
+    start = now();
+    for(int r = 0; r < rows; r++){
+        quantizeRow(input + size_t(r % BENCH_RING)*width, width, BENCH_MIN_DB, BENCH_MAX_DB, indices);
+        paletteRow(indices, width, lut, out);
+    }
+    report("quantizeRow + paletteRow", now() - start, width, rows, out);
+
+    free(input);
+    free(out);
+    free(check);
+    free(indices);
+    return 0;
+}
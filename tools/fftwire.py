@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+
+"""
+Reference encoder for application/x-sdr-fft frames, the FFT wire format the
+gui reads (see fftwire.h). The radio process publishes one frame per FFT:
+
+    encoder = FFTWireEncoder("u8")
+    body = encoder.encode(bins_db, center, span)
+    channel.basic_publish(exchange='', routing_key='radio_data', body=body,
+        properties=pika.BasicProperties(content_type=encoder.content_type))
+
+The gui asks for a format by sending {"fftFormat": "application/x-sdr-fft; sample=f32"}
+in its json config, use parse_content_type() on that value to pick the encoder.
+It asks for compression with {"fftEncoding": "x-sdr-delta-zlib"}, pass compress=True
+and publish with content_encoding=encoder.content_encoding.
+"""
+
+import struct
+import sys
+import time
+import zlib
+
+import numpy as np
+
+MAGIC        = 0x54464653  # "SFFT"
+VERSION      = 1
+CONTENT_TYPE = "application/x-sdr-fft"
+ENCODING     = "x-sdr-delta-zlib"
+
+FLAG_DELTA   = 0x01
+
+F64   = 0
+F32   = 1
+CDB16 = 2
+U8    = 3
+
+TYPE_NAMES = {"f64": F64, "f32": F32, "cdb16": CDB16, "u8": U8}
+
+# magic, version, header size, sample type, flags, reserved, bins,
+# center, span, sequence, timestamp, scale min, scale step
+HEADER = struct.Struct("<IHHBBHIddQqff")
+
+CENTI_DB_SCALE = 100.0
+
+
+def parse_content_type(content_type):
+    """Sample type asked for by a content type, None if it is not an x-sdr-fft type."""
+    parts = [p.strip() for p in content_type.split(";")]
+    if parts[0] != CONTENT_TYPE:
+        return None
+    for p in parts[1:]:
+        if p.startswith("sample="):
+            return TYPE_NAMES.get(p[len("sample="):])
+    return F32
+
+
+# integer types are delta coded by subtraction, float types by xor of their bits
+DELTA_VIEW = {F64: np.uint64, F32: np.uint32, CDB16: np.uint16, U8: np.uint8}
+
+
+class FFTWireEncoder:
+    def __init__(self, sample_type=F32, floor_db=-120.0, ceiling_db=0.0,
+                 compress=False, key_interval=32, level=1):
+        """
+        sample_type: F64, F32, CDB16, U8 or their names
+        floor_db, ceiling_db: range the 256 levels of U8 cover, anything outside is clipped
+        compress: x-sdr-delta-zlib, bins are delta coded against the previous frame,
+            byte shuffled and deflated
+        key_interval: frames between key frames, a receiver that missed a frame
+            picks up again at the next one
+        level: zlib level, on spectra 1 comes within a few percent of 9 for less CPU
+        """
+        if isinstance(sample_type, str):
+            sample_type = TYPE_NAMES[sample_type]
+        self.sample_type  = sample_type
+        self.floor_db     = float(floor_db)
+        self.step_db      = (float(ceiling_db) - self.floor_db)/255.0
+        self.sequence     = 0
+        self.content_type = CONTENT_TYPE
+        self.compress     = compress
+        self.key_interval = key_interval
+        self.level        = level
+        self.previous     = None
+        self.content_encoding = ENCODING if compress else "identity"
+
+    def encode(self, bins_db, center, span, timestamp=None):
+        """One frame: the header then the packed bins, bins_db is power in dB."""
+        bins_db = np.asarray(bins_db, dtype=np.float64)
+        if timestamp is None:
+            timestamp = int(time.time()*1e6)
+
+        if self.sample_type == F64:
+            payload = bins_db.astype("<f8")
+        elif self.sample_type == F32:
+            payload = bins_db.astype("<f4")
+        elif self.sample_type == CDB16:
+            payload = np.clip(np.rint(bins_db*CENTI_DB_SCALE), -32768, 32767).astype("<i2")
+        else:
+            payload = np.clip(np.rint((bins_db - self.floor_db)/self.step_db), 0, 255).astype(np.uint8)
+
+        flags = 0
+        data = payload.tobytes()
+        if self.compress:
+            values = payload.view(DELTA_VIEW[self.sample_type])
+            previous, self.previous = self.previous, values
+            if (previous is not None and len(previous) == len(values)
+                    and self.sequence % self.key_interval != 0):
+                flags |= FLAG_DELTA
+                if self.sample_type in (F64, F32):
+                    values = values ^ previous
+                else:
+                    values = values - previous  # wraps around
+            # byte planes, all the first bytes then all the second bytes, ...
+            width = values.dtype.itemsize
+            planes = values.view(np.uint8).reshape(len(values), width).T.tobytes()
+            data = zlib.compress(planes, self.level)
+
+        scale_min, scale_step = (self.floor_db, self.step_db) if self.sample_type == U8 else (0.0, 0.0)
+        header = HEADER.pack(MAGIC, VERSION, HEADER.size, self.sample_type, flags, 0, len(bins_db),
+                             float(center), float(span), self.sequence, timestamp, scale_min, scale_step)
+        self.sequence += 1
+        return header + data
+
+
+def decode(body, encoding=None, previous=None):
+    """
+    Header fields as a dict and the bins in dB, for checking an encoder.
+    For x-sdr-delta-zlib pass the previous frame's info["packed"] as previous.
+    """
+    (magic, version, header_size, sample_type, flags, _, bins,
+     center, span, sequence, timestamp, scale_min, scale_step) = HEADER.unpack_from(body)
+    if magic != MAGIC:
+        raise ValueError("not an x-sdr-fft frame")
+    dtype = {F64: "<f8", F32: "<f4", CDB16: "<i2", U8: np.uint8}[sample_type]
+    if encoding == ENCODING:
+        width = np.dtype(dtype).itemsize
+        planes = np.frombuffer(zlib.decompress(body[header_size:]), dtype=np.uint8)
+        packed = planes.reshape(width, bins).T.copy().view(DELTA_VIEW[sample_type]).ravel()
+        if flags & FLAG_DELTA:
+            if sample_type in (F64, F32):
+                packed = packed ^ previous
+            else:
+                packed = packed + previous
+    else:
+        packed = np.frombuffer(body, dtype=DELTA_VIEW[sample_type], count=bins, offset=header_size)
+    values = packed.view(dtype).astype(np.float64)
+    if sample_type == CDB16:
+        values /= CENTI_DB_SCALE
+    elif sample_type == U8:
+        values = scale_min + values*scale_step
+    return dict(version=version, sample_type=sample_type, center=center, span=span,
+                sequence=sequence, timestamp=timestamp, packed=packed), values
+
+
+def main():
+    # frame sizes, error and encode time of each format on a noisy spectrum with a few carriers,
+    # or on rows of float64 dB from a file: fftwire.py BINS [FILE]
+    bins = int(sys.argv[1]) if len(sys.argv) > 1 else 450
+    if len(sys.argv) > 2:
+        rows = np.fromfile(sys.argv[2], dtype="<f8")
+        rows = rows[:len(rows)//bins*bins].reshape(-1, bins)
+    else:
+        rng = np.random.default_rng(1)
+        carriers = np.zeros(bins)
+        carriers[rng.integers(0, bins, 6)] = rng.uniform(20.0, 60.0, 6)
+        carriers = np.convolve(carriers, np.hanning(7), mode="same")
+        rows = -100.0 + carriers + rng.normal(0.0, 1.5, (500, bins))
+
+    for name in TYPE_NAMES:
+        for compress in (False, True):
+            encoder = FFTWireEncoder(name, compress=compress)
+            start = time.perf_counter()
+            bodies = [encoder.encode(row, 100.0e6, 2.0e6) for row in rows]
+            elapsed = time.perf_counter() - start
+            size = sum(len(b) for b in bodies)/len(bodies)
+            error, previous = 0.0, None
+            for row, body in zip(rows, bodies):
+                info, values = decode(body, encoder.content_encoding, previous)
+                previous = info["packed"]
+                error = max(error, np.max(np.abs(values - row)))
+            print("{:>5} {:>16}: {:8.1f} bytes/frame, {:5.2f}x smaller than f64, max error {:.3f} dB, {:6.0f} frames/s".format(
+                name, encoder.content_encoding, size, rows.shape[1]*8.0/size, error, len(rows)/elapsed))
+
+
+if __name__ == '__main__':
+    main()
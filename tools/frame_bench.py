@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+
+"""
+Per-frame cost of getting a waterfall frame onto a widget, before and after the
+waterfall drew into a QImage. Needs PyQt5 (pip install PyQt5 numpy), runs
+without a display:
+
+    QT_QPA_PLATFORM=offscreen tools/frame_bench.py [WIDTH] [HEIGHT] [FRAMES]
+
+bmp      the old path, the pixels sit in an in-memory BMP file (14 byte file
+         header, 12 byte BITMAPCOREHEADER, bottom-up 32 bpp rows) that
+         QPixmap::loadFromData parses every frame, then the pixmap is drawn
+bmp-load only the parse, no drawing
+qimage   the new path, a QImage wraps the pixel buffer without copying and is
+         drawn straight from it
+
+Both draw into an RGB32 QImage the size of the frame, standing in for the
+widget's backing store. The pixels themselves are filled in beforehand and are
+the same for every frame, so only the hand-over is timed.
+"""
+
+import struct
+import sys
+import time
+
+import numpy as np
+from PyQt5.QtGui import QGuiApplication, QImage, QPainter, QPixmap
+
+BMP_HEADER_SIZE = 14
+BMP_BITMAPCOREHEADER_SIZE = 12
+
+
+def make_bmp(width, height, pixels):
+    """The old Waterfall::makeBmpHeader layout followed by the pixel rows."""
+    size = BMP_HEADER_SIZE + BMP_BITMAPCOREHEADER_SIZE + pixels.nbytes
+    header = struct.pack("<2sIHHI", b"BM", size, 0, 0, BMP_HEADER_SIZE + BMP_BITMAPCOREHEADER_SIZE)
+    core = struct.pack("<IHHHH", BMP_BITMAPCOREHEADER_SIZE, width, height, 1, 32)
+    return header + core + pixels.tobytes()
+
+
+def timed(frames, step):
+    start = time.perf_counter()
+    for _ in range(frames):
+        step()
+    return (time.perf_counter() - start)/frames*1e6
+
+
+def main():
+    width = int(sys.argv[1]) if len(sys.argv) > 1 else 350
+    height = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+    frames = int(sys.argv[3]) if len(sys.argv) > 3 else 2000
+    app = QGuiApplication(sys.argv)
+
+    rng = np.random.default_rng(1)
+    pixels = rng.integers(0, 1 << 24, (height, width), dtype=np.uint32) | np.uint32(0xFF000000)
+    bmp = make_bmp(width, height, pixels)
+    target = QImage(width, height, QImage.Format_RGB32)
+    painter = QPainter(target)
+
+    pixmap = QPixmap()
+    if not pixmap.loadFromData(bmp, "BMP"):
+        raise SystemExit("Qt could not read the BMP")
+
+    def old():
+        p = QPixmap()
+        p.loadFromData(bmp, "BMP")
+        painter.drawPixmap(0, 0, p)
+
+    def old_load():
+        p = QPixmap()
+        p.loadFromData(bmp, "BMP")
+
+    buffer = pixels.copy()
+    def new():
+        image = QImage(buffer.data, width, height, width*4, QImage.Format_RGB32)
+        painter.drawImage(0, 0, image)
+
+    print("{}x{} frames, {} frames".format(width, height, frames))
+    for name, step in (("bmp", old), ("bmp-load", old_load), ("qimage", new)):
+        print("{:>9}: {:8.1f} us/frame".format(name, timed(frames, step)))
+    painter.end()
+
+
+if __name__ == '__main__':
+    main()
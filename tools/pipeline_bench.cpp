@@ -0,0 +1,142 @@
+/*
+ * Benchmark of the FFT display pipeline per sample type, no Qt needed.
+ * Every row goes through what the radio and Waterfall do with a frame:
+ *   ingest    message body copied into a frame buffer, as the AMQP body allocator does
+ *   resample  bins to display columns, max-hold (Resampler), skipped if there are as many bins as columns
+ *   level     auto-level histogram and range update (AutoLevel)
+ *   colorize  columns to colormap indices to RGB32 pixels (quantizeRow, paletteRow)
+ * for double, float and int16 centi-dB bins, on the same spectra.
+ *
+ * Build from the repository root, add -march=native or -mavx2 to get the AVX2 kernels:
+ *   g++ -O2 -std=c++11 -I. tools/pipeline_bench.cpp resample.cpp autolevel.cpp colorize.cpp colormaps.cpp sampletype.cpp -o pipeline_bench
+ * Run:
+ *   ./pipeline_bench [BINS] [WIDTH] [ROWS]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "sampletype.h"
+#include "resample.h"
+#include "autolevel.h"
+#include "colorize.h"
+#include "colormaps.h"
+
+#define BENCH_BINS      2048        // bins per FFT frame
+#define BENCH_WIDTH     480         // display columns
+#define BENCH_ROWS      20000       // frames pushed through per sample type
+#define BENCH_RING_BYTES (8*1024*1024)  // message bodies cycled through, larger than L2 like fresh socket data
+
+/**
+ * @brief now time in seconds
+ */
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief runPipeline push rows of one sample type through ingest, resample, level and colorize
+ * @param name printed with the results
+ * @param spectra ring rows of bins values in dB
+ * @param ring number of rows in spectra
+ */
+template<typename T>
+static void runPipeline(const char* name, const double* spectra, int ring, int bins, int width, int rows){
+    // message bodies in the wire sample type, prepared up front like the radio process would
+    size_t bodyBytes = size_t(bins)*sizeof(T);
+    T* bodies = (T*)malloc(ring*bodyBytes);
+    for(int i = 0; i < ring*bins; i++){
+        bodies[i] = SampleTraits<T>::fromDb(spectra[i]);
+    }
+    T* frame = (T*)malloc(bodyBytes);
+    T* columns = (T*)malloc(width*sizeof(T));
+    uint8_t* indices = (uint8_t*)malloc(width);
+    uint32_t* pixels = (uint32_t*)malloc(width*sizeof(uint32_t));
+    const uint32_t* lut = colormap32(COLORMAP_CLASSIC);
+    Resampler resampler(RESAMPLE_MAX_HOLD);
+    AutoLevel level;
+
+    double ingest = 0.0;
+    double resample = 0.0;
+    double leveling = 0.0;
+    double colorize = 0.0;
+    uint32_t sum = 0;
+    double start = now();
+    for(int r = 0; r < rows; r++){
+        double t0 = now();
+        memcpy(frame, (const char*)bodies + size_t(r % ring)*bodyBytes, bodyBytes);
+        double t1 = now();
+        const T* values = frame;
+        if(bins != width){
+            resampler.resample(frame, bins, columns, width);
+            values = columns;   // a full view of width bins is used as it is, like Waterfall does
+        }
+        double t2 = now();
+        level.addRow(values, width);
+        level.update();
+        double t3 = now();
+        quantizeRow(values, width, level.getMin(), level.getMax(), indices);
+        paletteRow(indices, width, lut, pixels);
+        double t4 = now();
+        ingest += t1 - t0;
+        resample += t2 - t1;
+        leveling += t3 - t2;
+        colorize += t4 - t3;
+        sum = sum*31 + pixels[r % width];
+    }
+    double total = now() - start;
+
+    printf("%-8s %6zu B/frame %8.2f us/frame %9.0f frames/s | ingest %6.2f resample %6.2f level %6.2f colorize %6.2f us  (%08x)\n",
+           name, bodyBytes, total*1e6/rows, rows/total,
+           ingest*1e6/rows, resample*1e6/rows, leveling*1e6/rows, colorize*1e6/rows, sum);
+
+    free(bodies);
+    free(frame);
+    free(columns);
+    free(indices);
+    free(pixels);
+}
+
+int main(int argc, char** argv){
+    int bins = argc > 1 ? atoi(argv[1]) : BENCH_BINS;
+    int width = argc > 2 ? atoi(argv[2]) : BENCH_WIDTH;
+    int rows = argc > 3 ? atoi(argv[3]) : BENCH_ROWS;
+    if(bins <= 0 || width <= 0 || rows <= 0){
+        fprintf(stderr, "usage: %s [BINS] [WIDTH] [ROWS]\n", argv[0]);
+        return 1;
+    }
+
+#if defined(COLORIZE_AVX2)
+    printf("kernels: AVX2\n");
+#elif defined(COLORIZE_SSE2)
+    printf("kernels: SSE2\n");
+#elif defined(COLORIZE_NEON)
+    printf("kernels: NEON\n");
+#else
+    printf("kernels: scalar\n");
+#endif
+
+    // the double ring is the largest, the other types cycle through the same spectra
+    int ring = int(BENCH_RING_BYTES/(size_t(bins)*sizeof(double)));
+    ring = ring < 1 ? 1 : ring;
+    printf("%d bins to %d columns, %d frames, %d distinct frames\n", bins, width, rows, ring);
+
+    // a noise floor with a few carriers
+    double* spectra = (double*)malloc(size_t(ring)*bins*sizeof(double));
+    srand(1);
+    for(int r = 0; r < ring; r++){
+        for(int i = 0; i < bins; i++){
+            double noise = -100.0 + 6.0*rand()/RAND_MAX;
+            spectra[size_t(r)*bins + i] = i % (bins/7 + 1) < 3 ? -40.0 + noise/10.0 : noise;
+        }
+    }
+
+    runPipeline<double>("double", spectra, ring, bins, width, rows);
+    runPipeline<float>("float", spectra, ring, bins, width, rows);
+    runPipeline<int16_t>("int16", spectra, ring, bins, width, rows);
+
+    free(spectra);
+    return 0;
+}
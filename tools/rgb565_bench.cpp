@@ -0,0 +1,128 @@
+/*
+ * Benchmark of the waterfall's output formats on a 16 bpp screen, no Qt needed.
+ * Before, rows were drawn in RGB32 and Qt converted every frame to the screen's
+ * RGB565 on its way out, now rows are drawn in RGB565 or Indexed8 directly:
+ *   rgb32 + convert  paletteRow, then a 32 to 16 bpp pass like Qt's qConvertRgb32To16
+ *   rgb565           paletteRow16 with the colormap precomputed in RGB565
+ *   indexed8         the colormap indices are the pixels
+ * The quantizeRow that produces the indices is the same for all three and not timed.
+ *
+ * Build from the repository root:
+ *   g++ -O2 -std=c++11 -I. tools/rgb565_bench.cpp colorize.cpp colormaps.cpp -o rgb565_bench
+ * Run:
+ *   ./rgb565_bench [WIDTH] [HEIGHT] [FRAMES]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "colorize.h"
+#include "colormaps.h"
+
+#define BENCH_WIDTH     480         // the 480x320 TFT
+#define BENCH_HEIGHT    320
+#define BENCH_FRAMES    2000
+
+/**
+ * @brief now time in seconds
+ */
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief convertRow32To16 RGB32 to RGB565 by truncation, what Qt does for Format_RGB32 to Format_RGB16
+ */
+static void convertRow32To16(const uint32_t* src, int n, uint16_t* dest){
+    for(int i = 0; i < n; i++){
+        uint32_t s = src[i];
+        dest[i] = uint16_t(((s >> 3) & 0x001F) | ((s >> 5) & 0x07E0) | ((s >> 8) & 0xF800));
+    }
+}
+
+/**
+ * @brief report print the cost of one variant per row and per frame
+ */
+static void report(const char* name, double seconds, int height, int frames, uint32_t sum){
+    double rows = double(height)*frames;
+    printf("%-18s %8.3f us/row %8.1f us/frame  (%08x)\n", name, seconds*1e6/rows, seconds*1e6/frames, sum);
+}
+
+int main(int argc, char** argv){
+    int width = argc > 1 ? atoi(argv[1]) : BENCH_WIDTH;
+    int height = argc > 2 ? atoi(argv[2]) : BENCH_HEIGHT;
+    int frames = argc > 3 ? atoi(argv[3]) : BENCH_FRAMES;
+    if(width <= 0 || height <= 0 || frames <= 0){
+        fprintf(stderr, "usage: %s [WIDTH] [HEIGHT] [FRAMES]\n", argv[0]);
+        return 1;
+    }
+
+    // one frame of colormap indices, from a noisy spectrum
+    uint8_t* indices = (uint8_t*)malloc(size_t(width)*height);
+    double* values = (double*)malloc(width*sizeof(double));
+    srand(1);
+    for(int y = 0; y < height; y++){
+        for(int i = 0; i < width; i++){
+            values[i] = -45.0 + 90.0*rand()/RAND_MAX;
+        }
+        quantizeRow(values, width, -50.0, 50.0, indices + size_t(y)*width);
+    }
+    uint32_t* rgb32 = (uint32_t*)malloc(size_t(width)*height*sizeof(uint32_t));
+    uint16_t* rgb16 = (uint16_t*)malloc(size_t(width)*height*sizeof(uint16_t));
+    uint8_t* indexed = (uint8_t*)malloc(size_t(width)*height);
+    const uint32_t* lut32 = colormap32(COLORMAP_CLASSIC);
+    const uint16_t* lut16 = colormap565(COLORMAP_CLASSIC);
+    printf("%dx%d frames, %d frames\n", width, height, frames);
+
+    uint32_t sum = 0;
+    double start = now();
+    for(int f = 0; f < frames; f++){
+        for(int y = 0; y < height; y++){
+            paletteRow(indices + size_t(y)*width, width, lut32, rgb32 + size_t(y)*width);
+        }
+        // Qt converts the whole image once it is drawn to the 16 bpp backing store
+        for(int y = 0; y < height; y++){
+            convertRow32To16(rgb32 + size_t(y)*width, width, rgb16 + size_t(y)*width);
+        }
+        sum += rgb16[f % (width*height)];
+    }
+    report("rgb32 + convert", now() - start, height, frames, sum);
+
+    sum = 0;
+    start = now();
+    for(int f = 0; f < frames; f++){
+        for(int y = 0; y < height; y++){
+            paletteRow(indices + size_t(y)*width, width, lut32, rgb32 + size_t(y)*width);
+        }
+        sum += rgb32[f % (width*height)];
+    }
+    report("  of which rgb32", now() - start, height, frames, sum);
+
+    sum = 0;
+    start = now();
+    for(int f = 0; f < frames; f++){
+        for(int y = 0; y < height; y++){
+            paletteRow16(indices + size_t(y)*width, width, lut16, rgb16 + size_t(y)*width);
+        }
+        sum += rgb16[f % (width*height)];
+    }
+    report("rgb565", now() - start, height, frames, sum);
+
+    sum = 0;
+    start = now();
+    for(int f = 0; f < frames; f++){
+        for(int y = 0; y < height; y++){
+            memcpy(indexed + size_t(y)*width, indices + size_t(y)*width, width);
+        }
+        sum += indexed[f % (width*height)];
+    }
+    report("indexed8", now() - start, height, frames, sum);
+
+    free(indices);
+    free(values);
+    free(rgb32);
+    free(rgb16);
+    free(indexed);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Benchmark of waterfall scrolling, no Qt needed.
+ * Compares the old scroll, which memmoved the whole pixel buffer down one row
+ * for every frame, with the ring of rows Waterfall keeps now, where a new row
+ * only moves the head. Every variant colorizes the new row the same way, so
+ * the difference is the cost of scrolling. The ring is also timed with the two
+ * copies renderRows makes when a frame is published after every row.
+ *
+ * Build from the repository root:
+ *   g++ -O2 -std=c++11 -I. tools/scroll_bench.cpp colorize.cpp colormaps.cpp -o scroll_bench
+ * Run:
+ *   ./scroll_bench [HEIGHT] [ROWS]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "colorize.h"
+#include "colormaps.h"
+
+#define BENCH_HEIGHT    200         // rows in the waterfall
+#define BENCH_ROWS      20000       // rows appended per width
+#define BENCH_MIN_DB    -50.0
+#define BENCH_MAX_DB    50.0
+
+static const int widths[] = { 350, 1024, 4096 };
+
+/**
+ * @brief now time in seconds
+ */
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv){
+    int height = argc > 1 ? atoi(argv[1]) : BENCH_HEIGHT;
+    int rows = argc > 2 ? atoi(argv[2]) : BENCH_ROWS;
+    if(height <= 0 || rows <= 0){
+        fprintf(stderr, "usage: %s [HEIGHT] [ROWS]\n", argv[0]);
+        return 1;
+    }
+    const uint32_t* lut = colormap32(COLORMAP_CLASSIC);
+    printf("%d rows high, 32 bpp, %d rows appended\n", height, rows);
+    printf("%6s %14s %14s %22s\n", "width", "memmove rows/s", "ring rows/s", "ring+render rows/s");
+
+    for(int w = 0; w < int(sizeof(widths)/sizeof(widths[0])); w++){
+        int width = widths[w];
+        size_t rowBytes = size_t(width)*sizeof(uint32_t);
+        size_t pixelBytes = rowBytes*height;
+        uint8_t* pixels = (uint8_t*)malloc(pixelBytes);
+        uint8_t* frame = (uint8_t*)malloc(pixelBytes);
+        memset(pixels, 0, pixelBytes);
+        double* values = (double*)malloc(width*sizeof(double));
+        for(int i = 0; i < width; i++){
+            values[i] = -45.0 + 90.0*rand()/RAND_MAX;
+        }
+        uint32_t sum = 0;
+
+        // old: shiftRowsDown(1) then the new row at the end of the buffer (bottom-up BMP)
+        double start = now();
+        for(int r = 0; r < rows; r++){
+            memmove(pixels, pixels + rowBytes, pixelBytes - rowBytes);
+            colorizeRow(values, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, (uint32_t*)(pixels + pixelBytes - rowBytes));
+            sum += pixels[r % pixelBytes];
+        }
+        double memmoveRate = rows/(now() - start);
+
+        // ring: the head walks backwards, only the new row is written
+        int head = 0;
+        start = now();
+        for(int r = 0; r < rows; r++){
+            head = (head + height - 1) % height;
+            colorizeRow(values, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, (uint32_t*)(pixels + head*rowBytes));
+            sum += pixels[r % pixelBytes];
+        }
+        double ringRate = rows/(now() - start);
+
+        // ring and a published frame per row: newest rows to the top, the wrapped ones under them
+        start = now();
+        for(int r = 0; r < rows; r++){
+            head = (head + height - 1) % height;
+            colorizeRow(values, width, BENCH_MIN_DB, BENCH_MAX_DB, lut, (uint32_t*)(pixels + head*rowBytes));
+            int newest = height - head;
+            memcpy(frame, pixels + head*rowBytes, newest*rowBytes);
+            memcpy(frame + newest*rowBytes, pixels, head*rowBytes);
+            sum += frame[r % pixelBytes];
+        }
+        double renderRate = rows/(now() - start);
+
+        printf("%6d %14.0f %14.0f %22.0f  (%u)\n", width, memmoveRate, ringRate, renderRate, sum);
+        free(pixels);
+        free(frame);
+        free(values);
+    }
+    return 0;
+}
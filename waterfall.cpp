@@ -1,204 +1,749 @@
 #include "waterfall.h"
 
+/**
+ * @brief projectPixels resample one scanline onto another frequency axis
+ * @param src width pixels on the row's own axis
+ * @param dst width pixels on the view's axis
+ * @param width pixels per scanline
+ * @param start source position of the left edge of dst, in source pixels
+ * @param scale source pixels per destination pixel
+ * @param neutral pixel for columns outside the source row
+ * a pure shift is two fills and a memcpy, a span change picks the nearest source pixel
+ */
+template<typename T>
+static void projectPixels(const T* src, T* dst, int width, double start, double scale, T neutral){
+    if(scale == 1.0){
+        long shift = lround(start);
+        int first = int(shift < 0 ? (-shift < width ? -shift : width) : 0);   // dst columns left of the data
+        int last  = int(shift > 0 ? (shift < width ? width - shift : 0) : width); // dst columns up to the end of the data
+        for(int x = 0; x < first; x++){
+            dst[x] = neutral;
+        }
+        if(last > first){
+            memcpy(dst + first, src + first + shift, (last - first)*sizeof(T));
+        }
+        for(int x = last > first ? last : first; x < width; x++){
+            dst[x] = neutral;
+        }
+        return;
+    }
+    for(int x = 0; x < width; x++){
+        double s = start + (x + 0.5)*scale;
+        dst[x] = (s >= 0.0 && s < width) ? src[int(s)] : neutral;
+    }
+}
+
 /**
  * @brief Waterfall::Waterfall constructor
  * @param parent used for QObject
  * @param width width in pixels of the waterfall
  * @param maxHeight height in pixels of the waterfall
+ * @param format pixel format of the rows, QImage::Format_RGB32, Format_RGB16 or Format_Indexed8
+ * drawing rows in the screen's own format saves Qt converting every frame on the way out
  */
-Waterfall::Waterfall(QObject *parent, int width, int maxHeight) :
+Waterfall::Waterfall(QObject *parent, int width, int maxHeight, QImage::Format format) :
     QObject(parent)
 {
     this->width = width;
     this->maxHeight = maxHeight;
-    this->fftHalf = (this->fftMin + this->fftMax)/2.0;
 
-    int bytes_per_row = ((this->bpp*this->width + 31)/32)*4;
-    this->pixelBytes = bytes_per_row*this->maxHeight;
-    this->bmpFileSize = BMP_HEADER_SIZE + BMP_BITMAPCOREHEADER_SIZE + this->pixelBytes;
+    switch(format){
+    case QImage::Format_RGB16:
+        this->bpp = 16;
+        break;
+    case QImage::Format_Indexed8:
+        this->bpp = 8;
+        break;
+    default:
+        format = QImage::Format_RGB32;
+        this->bpp = 32;
+        break;
+    }
+    this->format = format;
+
+    this->bytesPerRow = ((this->bpp*this->width + 31)/32)*4;
+    this->pixelBytes = this->bytesPerRow*this->maxHeight;
+
+    this->pixels = (uchar*)malloc(this->pixelBytes); // allocate memory for the ring of rows
+    memset(this->pixels, 0, this->pixelBytes);
+
+    // power-to-pixel-value look-up-tables, generated at compile time in every format
+    this->lut = colormap32(COLORMAP_CLASSIC);
+    this->lut16 = colormap565(COLORMAP_CLASSIC);
+
+    this->frames[0].image = QImage(this->width, this->maxHeight, this->format);
+    this->frames[1].image = QImage(this->width, this->maxHeight, this->format);
+    if(this->format == QImage::Format_Indexed8){
+        // pixels are the colormap indices themselves, the colormap is the color table
+        QVector<QRgb> colors(COLORMAP_SIZE);
+        memcpy(colors.data(), this->lut, COLORMAP_SIZE*sizeof(QRgb));
+        this->frames[0].image.setColorTable(colors);
+        this->frames[1].image.setColorTable(colors);
+        this->frames[0].palette = this->lut;
+        this->frames[1].palette = this->lut;
+    }
+    for(int y = 0; y < this->maxHeight; y++){
+        this->blankLine(this->pixels + y*this->bytesPerRow);
+        this->blankLine(this->frames[0].image.scanLine(y));
+        this->blankLine(this->frames[1].image.scanLine(y));
+    }
+    this->front.storeRelease(0);
+    this->painting.storeRelease(-1);
+
+    this->row = malloc(this->width*sizeof(double)); // big enough for the widest sample type
+    memset(this->row, 0, this->width*sizeof(double));
+    this->merged = (double*)malloc(this->width*sizeof(double));
+
+    this->indices = (uint8_t*)malloc(this->width);
+    this->remapped = (uint8_t*)malloc(this->width);
+    this->scratch = (uchar*)malloc(this->bytesPerRow);
+    this->ringTuning = new RowTuning[this->maxHeight];
+    this->history = new WaterfallHistory(this->width);
+}
 
-    this->bmp = (uchar*)malloc(this->bmpFileSize); // allocate memory for our BMP "file"
 
-    this->makeBmpHeader();
+Waterfall::~Waterfall(){
+    free(this->pixels);
+    free(this->row);
+    free(this->merged);
+    free(this->indices);
+    free(this->remapped);
+    free(this->scratch);
+    delete[] this->ringTuning;
+    delete this->history;
+}
 
-    // create our power-to-pixel-value look-up-table
-    lutSize = (fftMax - fftMin)*resolution + 1;
-    this->lut = (Pixel*)malloc(lutSize * sizeof(Pixel));
-    double pwr = fftMin; // pwr in dBm
-    for(int i = 0; i < lutSize; i++){
-        // start with blue
-        double blue = fftHalf - pwr;
-        blue = constrain(blue, 0.0, fftHalf - fftMin);
+/**
+ * @brief Waterfall::appendFFT slot for external process to add new fft data
+ * @param fft
+ * publishes a new frame, then emits rowsAdded for a live view, viewChanged otherwise
+ */
+void Waterfall::appendFFT(const QVector<double>& fft){
+    this->frameTimestamp = 0;
+    this->appendSamples(fft.constData(), fft.size());
+}
 
-        // now green
-        double green = fftHalf - fabs(fftHalf - pwr);
-        green = constrain(green, 0.0, fftHalf - fabs(fftHalf));
+/**
+ * @brief Waterfall::appendFrame slot for frames straight from the radio, read in their own sample type
+ * @param frame shared with the other receivers, only read
+ * frames that know their center and span retune the waterfall themselves
+ */
+void Waterfall::appendFrame(const FFTFrameRef& frame){
+    const FFTFrameInfo& info = frame->getInfo();
+    this->frameTuning = info.span > 0.0;
+    if(this->frameTuning && (info.center != this->radioTuning.center || info.span != this->radioTuning.span)){
+        this->radioTuning.center = info.center;
+        this->radioTuning.span = info.span;
+        this->retune();
+    }
+    this->frameTimestamp = info.timestamp;
+
+    switch(frame->getType()){
+    case SAMPLE_FLOAT:
+        this->appendSamples(frame->samples<float>(), frame->getBins());
+        break;
+    case SAMPLE_CENTI_DB:
+        this->appendSamples(frame->samples<int16_t>(), frame->getBins());
+        break;
+    default:
+        this->appendSamples(frame->samples<double>(), frame->getBins());
+        break;
+    }
+}
 
-        // lastly red
-        double red = pwr - fftHalf;
-        red = constrain(red, 0.0, fftMax - fftHalf);
+/**
+ * @brief Waterfall::appendRow add new fft data without going through a QVector
+ * @param fft fft values in dB, only read during the call
+ * @param size number of values
+ * lets recordings be played back straight from a memory mapped file
+ */
+void Waterfall::appendRow(const double* fft, int size){
+    this->frameTimestamp = 0;
+    this->appendSamples(fft, size);
+}
 
-        lut[i].blue = uchar(map(blue, 0.0, fftHalf - fftMin, 0.0, 255.0) + 0.5);
-        lut[i].green = uchar(map(green, 0.0, fftHalf - fabs(fftHalf), 0.0, 255.0) + 0.5);
-        lut[i].red = uchar(map(red, 0.0, fftMax - fftHalf, 0.0, 255.0) + 0.5);
-        lut[i].alpha = 0;
+/**
+ * @brief Waterfall::appendSamples add new fft data in any supported sample type
+ * @param fft double or float dB, or int16 centi-dB, only read during the call
+ * @param size number of values
+ * resampling, auto-level and quantizing all run on the incoming type, frames are
+ * only widened to doubles when several are merged into one row
+ */
+template<typename T>
+void Waterfall::appendSamples(const T* fft, int size){
+    const T* values = fft;
+    if(size != this->width || !this->resampler.isFullView()){
+        this->resampler.resample(fft, size, (T*)this->row, this->width);
+        values = (const T*)this->row;
+    }
 
-        pwr += 1.0/resolution;
+    if(this->rowPeriod > 0){
+        if(!this->mergeRow(values)){
+            return; // the row period is not over yet
+        }
+        this->addRow((const double*)this->merged);
+        return;
     }
+    this->addRow(values);
 }
 
+/**
+ * @brief Waterfall::addRow turn one finished row into pixels and publish it
+ * @param values width values
+ */
+template<typename T>
+void Waterfall::addRow(const T* values){
+    // the pixel array is a ring of rows, move the head instead of shifting everything
+    this->advanceHead();
+
+    if(this->autoLevel){
+        // the colormap is normalized, following the signal is just a new min/max
+        this->level.addRow(values, this->width);
+        if(this->level.update()){
+            this->fftMin = this->level.getMin();
+            this->fftMax = this->level.getMax();
+        }
+    }
 
-Waterfall::~Waterfall(){
-    free(this->bmp);
-    free(this->lut);
+    this->addNewRow(values);
+
+    if(this->viewOffset > 0){
+        this->viewOffset++; // keep a scrolled-back view still while new rows arrive
+    }
+
+    this->rowCount++;
+    if(!this->isLive()){
+        this->generation++; // zoomed-out rows merge as they arrive, the whole view changes
+    }
+    this->publish();
 }
 
 /**
- * @brief Waterfall::appendFFT slot for external process to add new fft data
- * @param fft
- * will emit the pixmapReady signal when bitmap is formed
+ * @brief Waterfall::mergeRow combine a frame into the row being built
+ * @param values width values
+ * @return true if the row period is over and merged holds a finished row in dB
  */
-void Waterfall::appendFFT(const QVector<double>& fft){
+template<typename T>
+bool Waterfall::mergeRow(const T* values){
+    double* __restrict acc = this->merged;
+    const T* __restrict x = values;
+    int n = this->width;
+
+    if(this->mergedFrames == 0){
+        widenSamples(x, n, acc);
+    }else if(this->rowMerge == ROW_MERGE_MEAN){
+        for(int i = 0; i < n; i++){
+            acc[i] += SampleTraits<T>::toDb(x[i]);
+        }
+    }else{
+        for(int i = 0; i < n; i++){
+            double db = SampleTraits<T>::toDb(x[i]);
+            acc[i] = db > acc[i] ? db : acc[i];
+        }
+    }
+    this->mergedFrames++;
 
-    // shift all existing pixels down
-    this->shiftRowsDown(1);
+    qint64 now = this->rowClock.elapsed();
+    if(now < this->rowDeadline){
+        return false;
+    }
+
+    if(this->rowMerge == ROW_MERGE_MEAN && this->mergedFrames > 1){
+        double scale = 1.0/this->mergedFrames;
+        for(int i = 0; i < n; i++){
+            acc[i] *= scale;
+        }
+    }
+    this->mergedFrames = 0;
+
+    // stay on the row grid, unless frames stopped for longer than a row
+    this->rowDeadline += this->rowPeriod;
+    if(this->rowDeadline <= now){
+        this->rowDeadline = now + this->rowPeriod;
+    }
+    return true;
+}
 
-    if(fft.size() != this->width){
-        double* temp = (double*)malloc(this->width*sizeof(double));
-        memset(temp, 0, this->width*sizeof(double));
-        scale(temp, this->width, (double*)fft.data(), fft.size());
-        this->addNewRow(temp);
-        free(temp);
+/**
+ * @brief Waterfall::setRowPeriod fix the time each row covers
+ * @param ms milliseconds per row, 0 turns every frame into a row
+ * frames arriving within one period are merged, so the time scale no longer
+ * depends on the producer's frame rate
+ */
+void Waterfall::setRowPeriod(int ms){
+    this->rowPeriod = ms > 0 ? ms : 0;
+    this->mergedFrames = 0;
+    this->rowClock.start();
+    this->rowDeadline = this->rowPeriod;
+}
+
+/**
+ * @brief Waterfall::setRowMerge choose how frames within a row period are combined
+ * @param mode a RowMerge
+ */
+void Waterfall::setRowMerge(int mode){
+    this->rowMerge = RowMerge(mode);
+    this->mergedFrames = 0;
+}
+
+/**
+ * @brief Waterfall::setColormap switch to another built-in colormap
+ * @param colormap a Colormap
+ * the tables are constant, switching is a pointer swap. Rows still held as
+ * colormap indices in the history are repainted, Indexed8 only swaps color tables.
+ */
+void Waterfall::setColormap(int colormap){
+    this->lut = colormap32(colormap);
+    this->lut16 = colormap565(colormap);
+
+    if(this->format != QImage::Format_Indexed8){
+        for(int age = 0; age < this->maxHeight; age++){
+            const uint8_t* stored = this->history->getRow(0, age);
+            if(stored == nullptr){
+                break; // older rows keep the old colors until they scroll out
+            }
+            this->paletteLine(stored, this->pixels + ((this->head + age) % this->maxHeight)*this->bytesPerRow);
+        }
+    }
+    this->generation++;
+    this->publish();
+}
+
+/**
+ * @brief Waterfall::publish draw the current view into the back frame and make it the front one
+ * if the GUI is still reading the back frame it tries again shortly, frames in between are skipped
+ */
+void Waterfall::publish(){
+    int back = 1 - this->front.loadAcquire();
+
+    // full barrier, pairs with the one in acquireFront
+    if(this->painting.fetchAndAddOrdered(0) == back){
+        if(!this->retryPending){
+            this->retryPending = true;
+            QTimer::singleShot(WATERFALL_RETRY_MS, this, &Waterfall::retryPublish);
+        }
+        return;
+    }
+
+    WaterfallFrame& frame = this->frames[back];
+    if(this->format == QImage::Format_Indexed8 && frame.palette != this->lut){
+        // the colormap changed, this frame is not on screen so its color table can be swapped
+        QVector<QRgb> colors(COLORMAP_SIZE);
+        memcpy(colors.data(), this->lut, COLORMAP_SIZE*sizeof(QRgb));
+        frame.image.setColorTable(colors);
+        frame.palette = this->lut;
+    }
+    if(this->isLive()){
+        this->renderRows(frame.image.bits(), frame.image.bytesPerLine());
     }else{
-        this->addNewRow((double*)fft.data());
+        this->renderHistory(frame.image);
     }
+    frame.rows = this->rowCount;
+    frame.generation = this->generation;
+    frame.viewOffset = this->viewOffset;
+    frame.viewLevel = this->viewLevel;
+    frame.timestamp = this->frameTimestamp;
 
-    QPixmap pixmap;
-    pixmap.loadFromData(this->bmp, getBmpSize(this->bmp), QImageReader::supportedImageFormats()[0]);
+    this->front.fetchAndStoreOrdered(back);
 
-    emit pixmapReady(pixmap);
+    if(this->isLive()){
+        emit rowsAdded(1);
+    }else{
+        emit viewChanged();
+    }
 }
 
+/**
+ * @brief Waterfall::retryPublish publish after waiting for the GUI to release the back frame
+ */
+void Waterfall::retryPublish(){
+    this->retryPending = false;
+    this->publish();
+}
 
 /**
- * @brief Waterfall::makeBmpHeader make the bmp header based on width and height parameters
+ * @brief Waterfall::acquireFront lock the front frame for reading, GUI side
+ * @return the frame, valid until releaseFront
+ * never blocks, the worker leaves a locked frame alone
  */
-void Waterfall::makeBmpHeader(){
-    this->bmp[0] = 0x42;
-    this->bmp[1] = 0x4D;
-    setBmpSize(this->bmp, this->bmpFileSize); // set file size
-    this->bmp[0x06] = 0;
-    this->bmp[0x07] = 0;
-    this->bmp[0x08] = 0;
-    this->bmp[0x09] = 0;
-    this->bmp[BMP_OFFSET_IND] = BMP_HEADER_SIZE + BMP_BITMAPCOREHEADER_SIZE; // skip file header and DIB header
+const WaterfallFrame* Waterfall::acquireFront(){
+    for(;;){
+        int index = this->front.loadAcquire();
+        this->painting.fetchAndStoreOrdered(index);
+        if(this->front.loadAcquire() == index){
+            return &this->frames[index];  // the worker saw the lock before reusing this frame
+        }
+    }
+}
 
-    this->bmp[BMP_DIB_SIZE_IND] = BMP_BITMAPCOREHEADER_SIZE;
-    this->bmp[BMP_DIB_WIDTH_IND] = uint16_t(this->width) & 0xFF;
-    this->bmp[BMP_DIB_WIDTH_IND+1] = (uint16_t(this->width) >> 8) & 0xFF;
-    this->bmp[BMP_DIB_HEIGHT_IND] = uint16_t(this->maxHeight) & 0xFF;
-    this->bmp[BMP_DIB_HEIGHT_IND+1] = (uint16_t(this->maxHeight) >> 8) & 0xFF;
-    this->bmp[BMP_DIB_PLANES_IND] = 1; // this must always be 1 according to wikipedia
-    this->bmp[BMP_DIB_BITS_PER_PIX_IND] = this->bpp;
-    this->bmp[BMP_DIB_BITS_PER_PIX_IND+1] = 0;
+/**
+ * @brief Waterfall::releaseFront unlock the frame returned by acquireFront
+ */
+void Waterfall::releaseFront(){
+    this->painting.fetchAndStoreOrdered(-1);
+}
 
+/**
+ * @brief Waterfall::getTimeOffset
+ * @return time offset of the frame on display, safe to call from the GUI thread
+ */
+qint64 Waterfall::getTimeOffset(){
+    qint64 offset = this->acquireFront()->viewOffset;
+    this->releaseFront();
+    return offset;
 }
 
 /**
- * @brief Waterfall::shiftRowsDown shift pixels in bmp "down" by nRows
- * @param nRows rows to shift down
+ * @brief Waterfall::getTimeLevel
+ * @return time level of the frame on display, safe to call from the GUI thread
  */
-void Waterfall::shiftRowsDown(int nRows){
-    int delta = nRows*this->width*(this->bpp/8);
-    uchar* dest = this->bmp + BMP_HEADER_SIZE + BMP_BITMAPCOREHEADER_SIZE;
-    uchar* src  = this->bmp + BMP_HEADER_SIZE + BMP_BITMAPCOREHEADER_SIZE + delta;
-    int size = this->pixelBytes - delta;    // how much memory we moving?
-    memmove(dest, src, size);
+int Waterfall::getTimeLevel(){
+    int level = this->acquireFront()->viewLevel;
+    this->releaseFront();
+    return level;
 }
 
 /**
- * @brief Waterfall::addNewRow converts values into pixel data and places it at the top of the bitmap (end of memory block)
- * @param values fft values to be converted into pixel data
- * assumes values is at least as large as the image width
+ * @brief Waterfall::getFrameTimestamp
+ * @return producer time in microseconds of the newest row on display, 0 if unknown, safe to call from the GUI thread
  */
-void Waterfall::addNewRow(double* values){
-    int bytes_per_pix = this->bpp/8;
-    uchar* pix_start = this->bmp + (this->bmpFileSize - bytes_per_pix*this->width);
-    for(int i = 0; i < this->width; i++){
-        this->doubleToPixel(values[i], pix_start + bytes_per_pix*i);
+qint64 Waterfall::getFrameTimestamp(){
+    qint64 timestamp = this->acquireFront()->timestamp;
+    this->releaseFront();
+    return timestamp;
+}
+
+/**
+ * @brief Waterfall::renderRows copy the ring of rows into a frame, newest first, in two copies
+ * @param target first scanline of a width x maxHeight image in the same format
+ * @param targetBytesPerLine scanline stride of target
+ * rows head..maxHeight-1 are the newest and land at the top,
+ * rows 0..head-1 wrapped around and land underneath them
+ */
+void Waterfall::renderRows(uchar* target, int targetBytesPerLine){
+    int newest = this->maxHeight - this->head;  // rows from the head to the end of the ring
+
+    if(this->staleRows > 0){
+        // some rows were captured before a retune, shift each onto the current axis
+        for(int y = 0; y < this->maxHeight; y++){
+            int ringRow = y < newest ? this->head + y : y - newest;
+            this->projectLine(this->pixels + ringRow*this->bytesPerRow, this->ringTuning[ringRow],
+                              target + y*targetBytesPerLine);
+        }
+        return;
+    }
+    if(targetBytesPerLine == this->bytesPerRow){
+        memcpy(target, this->pixels + this->head*this->bytesPerRow, newest*this->bytesPerRow);
+        memcpy(target + newest*this->bytesPerRow, this->pixels, this->head*this->bytesPerRow);
+        return;
+    }
+    for(int y = 0; y < this->maxHeight; y++){
+        int ringRow = y < newest ? this->head + y : y - newest;
+        memcpy(target + y*targetBytesPerLine, this->pixels + ringRow*this->bytesPerRow, this->bytesPerRow);
     }
 }
 
 /**
- * @brief Waterfall::doubleToPixel converts a double into a single pixel
- * @param value the value
- * @param pixData the memory location of the pixel
+ * @brief Waterfall::setTimeView scroll back and/or zoom out in time
+ * @param offset frames between the newest frame and the top row of the view, 0 follows live data
+ * @param level each displayed row covers 2^level frames, 0 is full resolution
  */
-void Waterfall::doubleToPixel(double value, uchar* pixData){
+void Waterfall::setTimeView(qint64 offset, int level){
+    level = nconstrain(level, 0, this->history->getLevels() - 1);
+    qint64 oldest = this->history->getFrames() - 1;
+    this->viewOffset = offset < 0 ? 0 : (offset > oldest ? (oldest > 0 ? oldest : 0) : offset);
+    this->viewLevel = level;
+    this->generation++;
+    this->publish();
+}
 
-    int ind = nconstrain(int(0.5 + (value - fftMin)*resolution), 0, lutSize - 1);
+/**
+ * @brief Waterfall::setHistoryBudget cap the memory used for scrollback, drops stored history
+ * @param bytes bytes available for stored rows
+ * @param levels number of time resolution levels
+ */
+void Waterfall::setHistoryBudget(qint64 bytes, int levels){
+    this->history->setBudget(size_t(bytes), levels);
+    this->viewOffset = 0;
+    this->viewLevel = 0;
+    this->generation++;
+    this->publish();
+}
 
-    // blue red green alpha
-    pixData[0] = lut[ind].blue;
-    pixData[1] = lut[ind].green;
-    pixData[2] = lut[ind].red;
-    pixData[3] = lut[ind].alpha;
 
+/**
+ * @brief Waterfall::setFFTMin set the power mapped to the bottom of the colormap, disables auto-level
+ * @param min power in dB
+ */
+void Waterfall::setFFTMin(double min){
+    this->setFFTRange(min, this->fftMax);
 }
 
-int nconstrain(int n, int min, int max){
-    return (n < min ? min : (n > max ? max : n));
+/**
+ * @brief Waterfall::setFFTMax set the power mapped to the top of the colormap, disables auto-level
+ * @param max power in dB
+ */
+void Waterfall::setFFTMax(double max){
+    this->setFFTRange(this->fftMin, max);
 }
 
-double constrain(double x, double min, double max){
-    return (x < min ? min : (x > max ? max : x));
+/**
+ * @brief Waterfall::setFFTRange set a manual colormap range, disables auto-level
+ * @param min power in dB mapped to the first colormap entry
+ * @param max power in dB mapped to the last colormap entry
+ * takes effect on the next row, the LUT does not need rebuilding
+ */
+void Waterfall::setFFTRange(double min, double max){
+    this->autoLevel = false;
+    this->fftMin = min;
+    this->fftMax = max;
 }
 
-int nmap(int x, int in_min, int in_max, int out_min, int out_max){
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+/**
+ * @brief Waterfall::setAutoLevel enable or disable following the signal level
+ * @param enable
+ */
+void Waterfall::setAutoLevel(bool enable){
+    if(enable && !this->autoLevel){
+        // start from whatever is displayed now and adapt from there
+        this->level.reset();
+        this->level.setRange(this->fftMin, this->fftMax);
+    }
+    this->autoLevel = enable;
 }
 
-double map(double x, double in_min, double in_max, double out_min, double out_max){
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+/**
+ * @brief Waterfall::advanceHead move the ring head to the row that will receive the next fft
+ * the head walks backwards so that reading forward from it goes from newest to oldest,
+ * the oldest row is overwritten and nothing else in the ring moves
+ */
+void Waterfall::advanceHead(){
+    this->head = (this->head + this->maxHeight - 1) % this->maxHeight;
+}
+
+/**
+ * @brief Waterfall::addNewRow converts values into pixel data and places it in the head row of the ring
+ * @param values fft values to be converted into pixel data
+ * assumes values is at least as large as the image width
+ */
+template<typename T>
+void Waterfall::addNewRow(const T* values){
+    quantizeRow(values, this->width, this->fftMin, this->fftMax, this->indices);
+    RowRange range;
+    range.min = this->fftMin;
+    range.max = this->fftMax;
+    this->history->addRow(this->indices, this->tuning, range);
+
+    this->paletteLine(this->indices, this->pixels + this->head*this->bytesPerRow);
+
+    // the head row was the oldest one, it may have been the last row from before a retune
+    RowTuning& old = this->ringTuning[this->head];
+    if(this->staleRows > 0 && (old.center != this->tuning.center || old.span != this->tuning.span)){
+        this->staleRows--;
+    }
+    old = this->tuning;
+}
+
+/**
+ * @brief Waterfall::paletteLine turn colormap indices into one scanline in the output format
+ * @param indices width colormap indices
+ * @param line scanline to fill
+ */
+void Waterfall::paletteLine(const uint8_t* indices, uchar* line){
+    switch(this->format){
+    case QImage::Format_RGB16:
+        paletteRow16(indices, this->width, this->lut16, (uint16_t*)line);
+        break;
+    case QImage::Format_Indexed8:
+        memcpy(line, indices, this->width);
+        break;
+    default:
+        paletteRow(indices, this->width, this->lut, (uint32_t*)line);
+        break;
+    }
+}
+
+/**
+ * @brief Waterfall::blankLine fill one scanline with the color shown where there is no data
+ * @param line scanline to fill
+ * black in RGB32 and RGB16, the bottom of the colormap in Indexed8
+ */
+void Waterfall::blankLine(uchar* line){
+    if(this->format == QImage::Format_RGB32){
+        uint32_t* pixels = (uint32_t*)line;
+        for(int x = 0; x < this->width; x++){
+            pixels[x] = 0xFF000000;
+        }
+    }else{
+        memset(line, 0, this->width*this->bpp/8);
+    }
 }
 
 /**
- * @brief scale scales array src to array dest with minimal losses
- * @param dest starts as an array of 0's, will be populated with scaled values computed from src
- * @param dest_size size of dest
- * @param src source data to fit into dest
- * @param src_size size of src
+ * @brief Waterfall::projectLine copy one scanline captured on another axis onto the view's axis
+ * @param line scanline in the waterfall's format
+ * @param from tuning the scanline was captured on
+ * @param target scanline to fill, columns outside the captured span get WATERFALL_NEUTRAL
+ * rows or views of unknown span are copied as they are
  */
-void scale(double* dest, int dest_size, double* src, int src_size){
-    int temp_size = dest_size*src_size;
+void Waterfall::projectLine(const uchar* line, const RowTuning& from, uchar* target){
+    if(from.span <= 0.0 || this->tuning.span <= 0.0){
+        memcpy(target, line, this->width*this->bpp/8);
+        return;
+    }
+    // source pixel under the left edge of the view, and source pixels per view pixel
+    double scale = this->tuning.span/from.span;
+    double start = ((this->tuning.center - from.center)/from.span + 0.5 - 0.5*scale)*this->width;
+
+    switch(this->format){
+    case QImage::Format_RGB16:
+        projectPixels((const uint16_t*)line, (uint16_t*)target, this->width, start, scale, rgb565(WATERFALL_NEUTRAL));
+        break;
+    case QImage::Format_Indexed8:
+        // every index is a colormap color, the bottom of the colormap stands in for neutral
+        projectPixels(line, target, this->width, start, scale, uchar(0));
+        break;
+    default:
+        projectPixels((const uint32_t*)line, (uint32_t*)target, this->width, start, scale, uint32_t(WATERFALL_NEUTRAL));
+        break;
+    }
+}
 
-    double weight_1 = double(src_size)/double(temp_size);
-    double weight_2 = double(dest_size)/double(src_size); // scaling from src to dest
-    double factor = double(temp_size)/double(dest_size); // to get the right dest index
+/**
+ * @brief Waterfall::setCenterFreq move the view's frequency axis, new rows are tagged with it
+ * @param freq center frequency in Hz
+ * ignored while the frames say what they were captured on
+ */
+void Waterfall::setCenterFreq(double freq){
+    if(this->frameTuning || freq == this->radioTuning.center){
+        return;
+    }
+    this->radioTuning.center = freq;
+    this->retune();
+}
 
-    for(int i = 0; i < temp_size; i++){
-        dest[int(i/factor)] += weight_2 * weight_1 * src[ int(i*weight_1) ];
+/**
+ * @brief Waterfall::setBandwidth change the span of the view's frequency axis, new rows are tagged with it
+ * @param bw span in Hz
+ * ignored while the frames say what they were captured on
+ */
+void Waterfall::setBandwidth(double bw){
+    if(this->frameTuning || bw == this->radioTuning.span){
+        return;
     }
+    this->radioTuning.span = bw;
+    this->retune();
+}
 
+/**
+ * @brief Waterfall::setFrequencyView zoom in on part of the band, rows already drawn are stretched to match
+ * @param start left edge of the view as a fraction of the band
+ * @param span width of the view as a fraction of the band, 1.0 shows the whole band
+ */
+void Waterfall::setFrequencyView(double start, double span){
+    double oldStart = this->resampler.getViewStart();
+    double oldSpan = this->resampler.getViewSpan();
+    this->resampler.setView(start, span);
+    if(this->resampler.getViewStart() == oldStart && this->resampler.getViewSpan() == oldSpan){
+        return;
+    }
+    this->retune();
 }
 
 /**
- * @brief getBmpSize reads the bmp size from the header
- * @param bmp the bitmap "file"
- * @return size read from the header
+ * @brief Waterfall::retune re-project the view after the tuning changed
+ * only the row tags are looked at here, pixels are shifted lazily when a frame is drawn
  */
-int getBmpSize(uchar* bmp){
-    return (bmp[BMP_SIZE_IND] | (bmp[BMP_SIZE_IND+1] << 8) | (bmp[BMP_SIZE_IND+2] << 16) | (bmp[BMP_SIZE_IND+3] << 24));
+void Waterfall::retune(){
+    // the resampler clamps the view, use what it settled on
+    double start = this->resampler.getViewStart();
+    double span = this->resampler.getViewSpan();
+    this->tuning.center = this->radioTuning.center + (start + span/2 - 0.5)*this->radioTuning.span;
+    this->tuning.span = this->radioTuning.span*span;
+
+    this->staleRows = 0;
+    for(int y = 0; y < this->maxHeight; y++){
+        const RowTuning& t = this->ringTuning[y];
+        if(t.center != this->tuning.center || t.span != this->tuning.span){
+            this->staleRows++;
+        }
+    }
+    this->mergedFrames = 0; // a row half built on the old axis would smear across both
+    this->generation++;
+    this->publish();
 }
 
 /**
- * @brief setBmpSize sets the bmp size header field to size
- * @param bmp the "file"
- * @param size the size of the "file" in bytes
+ * @brief Waterfall::formatForDepth pick the row format for a screen
+ * @param depth screen depth in bits per pixel
+ * @return QImage::Format_RGB16 for 16 bpp, Format_Indexed8 for 8 bpp, Format_RGB32 otherwise
  */
-void setBmpSize(uchar* bmp, int size){
-    bmp[BMP_SIZE_IND] = size & 0xFF;
-    bmp[BMP_SIZE_IND+1] = (size >> 8) & 0xFF;
-    bmp[BMP_SIZE_IND+2] = (size >> 16) & 0xFF;
-    bmp[BMP_SIZE_IND+3] = (size >> 24) & 0xFF;
+QImage::Format Waterfall::formatForDepth(int depth){
+    if(depth == 16){
+        return QImage::Format_RGB16;
+    }
+    if(depth == 8){
+        return QImage::Format_Indexed8;
+    }
+    return QImage::Format_RGB32;
+}
+
+/**
+ * @brief Waterfall::renderHistory draw the scrolled-back or zoomed-out view from the history store
+ * @param target width x maxHeight image in the waterfall's format
+ * rows are only palette lookups, nothing is resampled or merged again.
+ * Rows quantized against another dB range are brought onto the current one, so a
+ * color means the same power across the whole view.
+ */
+void Waterfall::renderHistory(QImage& target){
+    RowRange current;
+    current.min = this->fftMin;
+    current.max = this->fftMax;
+    RowRange tableRange = current;
+    uint8_t table[COLORMAP_SIZE];
+    for(int y = 0; y < this->maxHeight; y++){
+        qint64 age = this->viewOffset + (qint64(y) << this->viewLevel);
+        RowTuning from;
+        RowRange range;
+        const uint8_t* stored = this->history->getRow(this->viewLevel, age, &from, &range);
+        if(stored != nullptr && range != current){
+            if(range != tableRange){
+                requantizeTable(range, current, table);
+                tableRange = range;
+            }
+            for(int x = 0; x < this->width; x++){
+                this->remapped[x] = table[stored[x]];
+            }
+            stored = this->remapped;
+        }
+        uchar* line = target.scanLine(y);
+        if(stored != nullptr && from.center == this->tuning.center && from.span == this->tuning.span){
+            this->paletteLine(stored, line);
+        }else if(stored != nullptr){
+            this->paletteLine(stored, this->scratch);
+            this->projectLine(this->scratch, from, line);
+        }else{
+            this->blankLine(line); // nothing stored that far back
+        }
+    }
+}
+
+template void Waterfall::appendSamples<double>(const double* fft, int size);
+template void Waterfall::appendSamples<float>(const float* fft, int size);
+template void Waterfall::appendSamples<int16_t>(const int16_t* fft, int size);
+
+int nconstrain(int n, int min, int max){
+    return (n < min ? min : (n > max ? max : n));
+}
+
+double constrain(double x, double min, double max){
+    return (x < min ? min : (x > max ? max : x));
+}
+
+int nmap(int x, int in_min, int in_max, int out_min, int out_max){
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+double map(double x, double in_min, double in_max, double out_min, double out_max){
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
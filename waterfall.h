@@ -2,71 +2,158 @@
 #define WATERFALL_H
 
 #include <QObject>
-#include <QPixmap>
-#include <QImageReader>
+#include <QImage>
+#include <QPainter>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <cmath>
+#include "colorize.h"
+#include "colormaps.h"
+#include "resample.h"
+#include "autolevel.h"
+#include "waterfallhistory.h"
+#include "fftframe.h"
 
-#define BMP_SIZE 8192
-#define BMP_HEADER_SIZE 14
-#define BMP_SIZE_IND    0x02
-#define BMP_OFFSET_IND  0x0A
+#define WATERFALL_RETRY_MS  5   // wait before publishing again when the GUI still holds the back buffer
+#define WATERFALL_NEUTRAL   0xFF404040  // columns a retuned row has no data for
+#define WATERFALL_MAX_ZOOM  64          // narrowest frequency view is 1/64 of the band
 
-#define BMP_BITMAPCOREHEADER_SIZE 12
-#define BMP_DIB_SIZE_IND    0x0E
-#define BMP_DIB_WIDTH_IND   0x12
-#define BMP_DIB_HEIGHT_IND  0x14
-#define BMP_DIB_PLANES_IND  0x16
-#define BMP_DIB_BITS_PER_PIX_IND    0x18
-
-#define PIXEL_VALUE_MAX     16777216
-#define PIXEL_VALUE_HALF    PIXEL_VALUE_MAX/2
+/**
+ * @brief The RowMerge enum selects how frames arriving within one row period are combined
+ */
+enum RowMerge {
+    ROW_MERGE_MAX_HOLD, // loudest value of each pixel, short bursts stay visible
+    ROW_MERGE_MEAN      // average of each pixel, smoother noise floor
+};
 
-typedef struct {
-    uchar red;
-    uchar green;
-    uchar blue;
-    uchar alpha;
-}Pixel;
+/**
+ * @brief The WaterfallFrame struct is one finished view handed from the waterfall to the GUI
+ */
+struct WaterfallFrame {
+    QImage image;               // the view, newest row on top
+    quint64 rows = 0;           // rows appended to the waterfall when this frame was drawn
+    quint64 generation = 0;     // changes whenever the view changed as a whole, not just scrolled
+    qint64 viewOffset = 0;      // time view the frame shows
+    int viewLevel = 0;
+    qint64 timestamp = 0;       // producer time of the newest row in microseconds since the epoch, 0 if unknown
+    const uint32_t* palette = nullptr;  // colormap in the image's color table, Indexed8 only
+};
 
+/**
+ * @brief The Waterfall class turns FFT frames into a scrolling image
+ * It can live in its own thread. Each update is drawn into the back one of two
+ * frames and published by atomically swapping the front index, the GUI only
+ * ever blits the front frame between acquireFront and releaseFront.
+ * Rows remember the tuning they were captured on, after a retune they are
+ * shifted onto the new frequency axis while being copied into a frame.
+ * Zooming in on part of the band is a retune too, so history is kept.
+ * Self-describing frames tag their rows with the tuning they were captured on,
+ * a retune then takes effect on the first frame from the new frequency.
+ */
 class Waterfall : public QObject
 {
     Q_OBJECT
 public:
-    Waterfall(QObject *parent = nullptr, int width = 350, int maxHeight = 200);
+    Waterfall(QObject *parent = nullptr, int width = 350, int maxHeight = 200, QImage::Format format = QImage::Format_RGB32);
     ~Waterfall();
-    void setFFTMax(double max) { fftMax = max; fftHalf = fftMax/2.0; }
+    void setResampleMode(ResampleMode mode) { resampler.setMode(mode); }
+    Resampler* getResampler() { return &resampler; }
+    QImage::Format getFormat() { return format; }
+    static QImage::Format formatForDepth(int depth);
+    double getFFTMin() { return fftMin; }
+    double getFFTMax() { return fftMax; }
+    bool isAutoLevel() { return autoLevel; }
+    qint64 getTimeOffset();
+    int getTimeLevel();
+    qint64 getFrameTimestamp();
+    int getTimeLevels() { return history->getLevels(); }
+    const WaterfallFrame* acquireFront();
+    void releaseFront();
+    template<typename T> void appendSamples(const T* fft, int size);
 
 public slots:
     void appendFFT(const QVector<double>& fft);
+    void appendFrame(const FFTFrameRef& frame);
+    void appendRow(const double* fft, int size);
+    void setFFTMin(double min);
+    void setFFTMax(double max);
+    void setFFTRange(double min, double max);
+    void setAutoLevel(bool enable);
+    void setTimeView(qint64 offset, int level);
+    void setHistoryBudget(qint64 bytes, int levels);
+    void setRowPeriod(int ms);
+    void setRowMerge(int mode);
+    void setColormap(int colormap);
+    void setCenterFreq(double freq);
+    void setBandwidth(double bw);
+    void setFrequencyView(double start, double span);
+
+private slots:
+    void retryPublish();
 
 signals:
-    void pixmapReady(const QPixmap& pixmap);
+    void rowsAdded(int rows);
+    void viewChanged();
 
 private:
-    void makeBmpHeader();
-    void shiftRowsDown(int nRows);
-    void addNewRow(double* values);
-    void doubleToPixel(double value, uchar* pixData);
+    void advanceHead();
+    template<typename T> bool mergeRow(const T* values);
+    template<typename T> void addRow(const T* values);
+    template<typename T> void addNewRow(const T* values);
+    bool isLive() { return viewOffset == 0 && viewLevel == 0; }
+    void publish();
+    void renderRows(uchar* target, int targetBytesPerLine);
+    void renderHistory(QImage& target);
+    void paletteLine(const uint8_t* indices, uchar* line);
+    void blankLine(uchar* line);
+    void projectLine(const uchar* line, const RowTuning& from, uchar* target);
+    void retune();
     int width;
     int maxHeight;
-    int bmpFileSize;
     int pixelBytes;
+    int bytesPerRow;
+    int head = 0;   // row index in the pixel ring holding the newest row
     double fftMin = -50.0;
     double fftMax = 50.0;
-    double fftHalf;
-    double resolution = 100.0; // steps per dB
+    bool autoLevel = false;
+    AutoLevel level;    // streaming noise floor/peak estimates for auto-level mode
+    QImage::Format format;  // RGB32, RGB16 or Indexed8, whatever the screen uses natively
     uint8_t bpp = 32;
-    uchar* bmp;
-    double lutSize;
-    Pixel* lut;
+    uchar* pixels;  // ring of rows, top-down
+    WaterfallFrame frames[2];   // double buffered views
+    QAtomicInt front;           // index of the frame the GUI may read
+    QAtomicInt painting;        // index of the frame the GUI is reading, -1 if none
+    quint64 rowCount = 0;       // rows appended so far
+    quint64 generation = 0;     // bumped on whole-view changes
+    bool retryPending = false;  // a publish is scheduled because the back buffer was busy
+    Resampler resampler;
+    void* row;      // fft resampled to the waterfall width in its own sample type, room for doubles
+    double* merged; // frames of the current row period combined, preallocated
+    int mergedFrames = 0;       // frames in merged so far
+    int rowPeriod = 0;          // ms per row, 0 makes every frame a row
+    RowMerge rowMerge = ROW_MERGE_MAX_HOLD;
+    QElapsedTimer rowClock;
+    qint64 rowDeadline = 0;     // rowClock time at which the current row is complete
+    uint8_t* indices;   // newest row as colormap indices
+    uint8_t* remapped;  // one history row brought onto the current dB range
+    uchar* scratch;     // one scanline, history rows are paletted here before being projected
+    RowTuning radioTuning;      // frequency axis of the whole FFT frame
+    RowTuning tuning;           // frequency axis of the view, radioTuning narrowed by the zoom
+    RowTuning* ringTuning;      // frequency axis each ring row was captured on
+    bool frameTuning = false;   // the radio's frames carry their own axis, the GUI's tuning is ignored
+    qint64 frameTimestamp = 0;  // producer time of the newest frame, 0 if it didn't say
+    int staleRows = 0;          // ring rows captured on another axis than the view's
+    WaterfallHistory* history;
+    qint64 viewOffset = 0;  // frames between the newest frame and the top of the view
+    int viewLevel = 0;      // each displayed row covers 2^viewLevel frames
+    const uint32_t* lut;    // power-to-pixel-value look-up-table, built at compile time, small enough to stay in L1
+    const uint16_t* lut16;  // the same colormap as RGB565
 };
 
 int nconstrain(int n, int min, int max);
 double constrain(double x, double min, double max);
 int nmap(int x, int in_min, int in_max, int out_min, int out_max);
 double map(double x, double in_min, double in_max, double out_min, double out_max);
-void scale(double* dest, int dest_size, double* src, int src_size);
-int getBmpSize(uchar* bmp);
-void setBmpSize(uchar* bmp, int size);
 
 #endif // WATERFALL_H
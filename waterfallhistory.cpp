@@ -0,0 +1,202 @@
+#include "waterfallhistory.h"
+
+/**
+ * @brief WaterfallHistory::WaterfallHistory constructor
+ * @param width pixels per row
+ * @param budget bytes available for rows and their tuning and range
+ * @param levels number of resolution levels
+ */
+WaterfallHistory::WaterfallHistory(int width, size_t budget, int levels){
+    this->width = width;
+    this->budget = budget;
+    this->levels = levels;
+    this->allocate();
+}
+
+WaterfallHistory::~WaterfallHistory(){
+    free(this->storage);
+    free(this->pending);
+    free(this->tunings);
+    free(this->ranges);
+    free(this->pendingRanges);
+    free(this->head);
+    free(this->count);
+    free(this->pendingCount);
+}
+
+/**
+ * @brief WaterfallHistory::setBudget resize the store, existing history is dropped
+ * @param budget bytes available for rows and their tuning and range
+ * @param levels number of resolution levels
+ */
+void WaterfallHistory::setBudget(size_t budget, int levels){
+    this->budget = budget;
+    this->levels = levels;
+    this->allocate();
+}
+
+/**
+ * @brief WaterfallHistory::allocate size the rings so that every level fits in the budget
+ */
+void WaterfallHistory::allocate(){
+    if(this->levels < 1){
+        this->levels = 1;
+    }
+    // every stored row costs its pixels plus its tuning and dB range
+    this->rowsPerLevel = int(this->budget/(size_t(this->levels)*(this->width + sizeof(RowTuning) + sizeof(RowRange))));
+    if(this->rowsPerLevel < 1){
+        this->rowsPerLevel = 1;
+    }
+
+    this->storage      = (uint8_t*)realloc(this->storage, size_t(this->levels)*this->rowsPerLevel*this->width);
+    this->pending      = (uint8_t*)realloc(this->pending, size_t(this->levels)*this->width);
+    this->tunings      = (RowTuning*)realloc(this->tunings, size_t(this->levels)*this->rowsPerLevel*sizeof(RowTuning));
+    this->ranges       = (RowRange*)realloc(this->ranges, size_t(this->levels)*this->rowsPerLevel*sizeof(RowRange));
+    this->pendingRanges = (RowRange*)realloc(this->pendingRanges, this->levels*sizeof(RowRange));
+    this->head         = (int*)realloc(this->head, this->levels*sizeof(int));
+    this->count        = (int*)realloc(this->count, this->levels*sizeof(int));
+    this->pendingCount = (int*)realloc(this->pendingCount, this->levels*sizeof(int));
+    this->clear();
+}
+
+/**
+ * @brief WaterfallHistory::clear forget every stored row
+ */
+void WaterfallHistory::clear(){
+    memset(this->head, 0, this->levels*sizeof(int));
+    memset(this->count, 0, this->levels*sizeof(int));
+    memset(this->pendingCount, 0, this->levels*sizeof(int));
+    this->frames = 0;
+}
+
+/**
+ * @brief WaterfallHistory::addRow add the newest frame
+ * @param row width colormap indices
+ * @param tuning frequency axis of the row
+ * @param range dB range the row was quantized against
+ */
+void WaterfallHistory::addRow(const uint8_t* row, const RowTuning& tuning, const RowRange& range){
+    this->push(0, row, tuning, range);
+    this->frames++;
+}
+
+/**
+ * @brief WaterfallHistory::push store a row in a level and fold it into the level above
+ * @param level level to store in
+ * @param row width colormap indices
+ * @param tuning frequency axis of the row
+ * @param range dB range the row was quantized against
+ */
+void WaterfallHistory::push(int level, const uint8_t* row, const RowTuning& tuning, const RowRange& range){
+    this->head[level] = (this->head[level] + 1) % this->rowsPerLevel;
+    size_t slot = size_t(level)*this->rowsPerLevel + this->head[level];
+    memcpy(this->storage + slot*this->width, row, this->width);
+    this->tunings[slot] = tuning;
+    this->ranges[slot] = range;
+    if(this->count[level] < this->rowsPerLevel){
+        this->count[level]++;
+    }
+
+    if(level + 1 >= this->levels){
+        return;
+    }
+
+    // pairs of rows merge 2:1 with max-hold before moving up a level
+    uint8_t* acc = this->pending + size_t(level)*this->width;
+    RowRange& accRange = this->pendingRanges[level];
+    if(this->pendingCount[level] == 0){
+        memcpy(acc, row, this->width);
+        accRange = range;
+        this->pendingCount[level] = 1;
+        return;
+    }
+
+    if(range == accRange){
+        for(int i = 0; i < this->width; i++){
+            acc[i] = row[i] > acc[i] ? row[i] : acc[i];
+        }
+    }else{
+        // an index only means a power together with its range, merge on a range covering both
+        RowRange merged;
+        merged.min = range.min < accRange.min ? range.min : accRange.min;
+        merged.max = range.max > accRange.max ? range.max : accRange.max;
+        uint8_t fromAcc[COLORMAP_SIZE];
+        uint8_t fromRow[COLORMAP_SIZE];
+        requantizeTable(accRange, merged, fromAcc);
+        requantizeTable(range, merged, fromRow);
+        for(int i = 0; i < this->width; i++){
+            uint8_t a = fromAcc[acc[i]];
+            uint8_t r = fromRow[row[i]];
+            acc[i] = r > a ? r : a;
+        }
+        accRange = merged;
+    }
+    this->pendingCount[level] = 0;
+    this->push(level + 1, acc, tuning, accRange); // the newer row's axis wins if a retune falls inside the pair
+}
+
+/**
+ * @brief WaterfallHistory::getRow look up the stored row covering a frame
+ * @param level resolution level, each row covers 2^level frames
+ * @param age frames before the newest one, 0 is the newest
+ * @param tuning if not nullptr, set to the frequency axis of the row
+ * @param range if not nullptr, set to the dB range the row was quantized against
+ * @return width colormap indices, or nullptr if that far back isn't stored at this level
+ * Frames still waiting to be merged into this level are shown by its newest row.
+ */
+const uint8_t* WaterfallHistory::getRow(int level, int64_t age, RowTuning* tuning, RowRange* range){
+    if(level < 0 || level >= this->levels || age < 0 || age >= this->frames){
+        return nullptr;
+    }
+    int64_t waiting = this->frames & ((int64_t(1) << level) - 1); // frames not yet merged into this level
+    int64_t ind = age > waiting ? (age - waiting) >> level : 0;
+    if(ind >= this->count[level]){
+        return nullptr;
+    }
+    int ring = int((this->head[level] - ind % this->rowsPerLevel + this->rowsPerLevel) % this->rowsPerLevel);
+    size_t slot = size_t(level)*this->rowsPerLevel + ring;
+    if(tuning != nullptr){
+        *tuning = this->tunings[slot];
+    }
+    if(range != nullptr){
+        *range = this->ranges[slot];
+    }
+    return this->storage + slot*this->width;
+}
+
+/**
+ * @brief WaterfallHistory::getDepth how many frames back a level reaches when full
+ * @param level resolution level
+ * @return number of frames
+ */
+int64_t WaterfallHistory::getDepth(int level){
+    return int64_t(this->rowsPerLevel) << level;
+}
+
+/**
+ * @brief WaterfallHistory::getBytes memory in use for rows, their metadata and merge buffers
+ * @return bytes
+ */
+size_t WaterfallHistory::getBytes(){
+    size_t rows = size_t(this->levels)*this->rowsPerLevel;
+    return (rows + this->levels)*this->width                    // storage and pending
+         + rows*(sizeof(RowTuning) + sizeof(RowRange))          // tunings and ranges
+         + this->levels*(sizeof(RowRange) + 3*sizeof(int));     // pendingRanges, head, count, pendingCount
+}
+
+/**
+ * @brief requantizeTable map the colormap indices of one dB range onto another
+ * @param from range the indices were quantized against
+ * @param to range to express them in
+ * @param table COLORMAP_SIZE entries, table[index in from] is the index in to
+ * each index stands for the power at its center, the same rounding quantizeRow uses
+ */
+void requantizeTable(const RowRange& from, const RowRange& to, uint8_t* table){
+    double fromStep = (from.max > from.min ? from.max - from.min : 1.0)/(COLORMAP_SIZE - 1);
+    double toSpan = to.max > to.min ? to.max - to.min : 1.0;
+    double scale = (COLORMAP_SIZE - 1)/toSpan;
+    for(int i = 0; i < COLORMAP_SIZE; i++){
+        double x = (from.min + i*fromStep - to.min)*scale + 0.5;
+        table[i] = uint8_t(x > 0.0 ? (x < COLORMAP_SIZE - 1 ? int(x) : COLORMAP_SIZE - 1) : 0);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef WATERFALLHISTORY_H
+#define WATERFALLHISTORY_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "colorize.h"
+
+#define HISTORY_DEFAULT_BUDGET  (4*1024*1024)   // bytes of rows and their metadata
+#define HISTORY_DEFAULT_LEVELS  8               // level k holds rows of 2^k frames
+
+/**
+ * @brief The RowTuning struct is the frequency axis a row was captured on
+ */
+struct RowTuning {
+    double center = 0.0;    // Hz at the middle of the row
+    double span = 0.0;      // Hz across the whole row, 0 if unknown
+};
+
+/**
+ * @brief The RowRange struct is the dB range a row's colormap indices were quantized against
+ */
+struct RowRange {
+    double min = 0.0;       // dB of index 0
+    double max = 0.0;       // dB of index COLORMAP_SIZE - 1
+    bool operator==(const RowRange& other) const { return min == other.min && max == other.max; }
+    bool operator!=(const RowRange& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief The WaterfallHistory class is a bounded-memory, multi-resolution store of waterfall rows
+ * Rows are kept as colormap indices, one byte per pixel. Level 0 holds the most
+ * recent rows at full resolution, level k holds rows that are the max-hold of
+ * 2^k consecutive frames, so each level reaches twice as far back as the one below.
+ * Every level is a ring of the same number of rows, sized to fit the memory budget.
+ * Adding a frame costs at most width*(1 + 1/2 + 1/4 + ...) byte operations.
+ * Each row keeps the tuning it was captured on, a merged row keeps the newest one.
+ * Each row also keeps the dB range it was quantized against, auto-level moves
+ * that range, so rows of a pair are brought onto the wider of their ranges
+ * before they are merged.
+ */
+class WaterfallHistory
+{
+public:
+    WaterfallHistory(int width, size_t budget = HISTORY_DEFAULT_BUDGET, int levels = HISTORY_DEFAULT_LEVELS);
+    ~WaterfallHistory();
+    void setBudget(size_t budget, int levels);
+    void clear();
+    void addRow(const uint8_t* row, const RowTuning& tuning, const RowRange& range);
+    const uint8_t* getRow(int level, int64_t age, RowTuning* tuning = nullptr, RowRange* range = nullptr);
+    int getLevels() { return levels; }
+    int getRowsPerLevel() { return rowsPerLevel; }
+    int64_t getFrames() { return frames; }
+    int64_t getDepth(int level);
+    size_t getBytes();
+
+private:
+    void allocate();
+    void push(int level, const uint8_t* row, const RowTuning& tuning, const RowRange& range);
+    int width;
+    int levels;
+    int rowsPerLevel;
+    size_t budget;
+    uint8_t* storage = nullptr;     // levels rings of rowsPerLevel rows each
+    uint8_t* pending = nullptr;     // per level, the max-hold of rows waiting to move up a level
+    RowTuning* tunings = nullptr;   // per stored row, parallel to storage
+    RowRange* ranges = nullptr;     // per stored row, parallel to storage
+    RowRange* pendingRanges = nullptr;  // per level, range of pending
+    int* head = nullptr;            // per level, ring index of the newest row
+    int* count = nullptr;           // per level, rows stored so far
+    int* pendingCount = nullptr;    // per level, rows merged into pending
+    int64_t frames = 0;             // frames added since the last clear
+};
+
+void requantizeTable(const RowRange& from, const RowRange& to, uint8_t* table);
+
+#endif // WATERFALLHISTORY_H
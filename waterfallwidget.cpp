@@ -0,0 +1,324 @@
+#include "waterfallwidget.h"
+
+/**
+ * @brief WaterfallWidget::WaterfallWidget constructor
+ * @param parent
+ */
+WaterfallWidget::WaterfallWidget(QWidget *parent) :
+    QWidget(parent)
+{
+    // every pixel is painted by us, Qt does not need to clear the background first
+    // and can move the existing contents when scrolling
+    this->setAttribute(Qt::WA_OpaquePaintEvent);
+    this->setAutoFillBackground(false);
+
+    this->setMaxFps(WATERFALL_DEFAULT_FPS);
+    connect(&this->timer, &QTimer::timeout, this, &WaterfallWidget::flush);
+    this->statsClock.start();
+}
+
+/**
+ * @brief WaterfallWidget::setWaterfall display waterfall, it should be as large as the widget
+ * @param waterfall
+ */
+void WaterfallWidget::setWaterfall(Waterfall* waterfall){
+    if(this->waterfall != nullptr){
+        disconnect(this->waterfall, nullptr, this, nullptr);
+    }
+    this->waterfall = waterfall;
+    if(waterfall != nullptr){
+        connect(waterfall, &Waterfall::rowsAdded, this, &WaterfallWidget::rowsAdded);
+        connect(waterfall, &Waterfall::viewChanged, this, &WaterfallWidget::viewChanged);
+    }
+    this->viewChanged();
+}
+
+/**
+ * @brief WaterfallWidget::setMaxFps cap how often the widget repaints
+ * @param fps frames per second
+ */
+void WaterfallWidget::setMaxFps(int fps){
+    this->timer.setInterval(fps > 0 ? 1000/fps : 0);
+}
+
+/**
+ * @brief WaterfallWidget::rowsAdded slot for new rows at the top of a live waterfall
+ * @param rows number of new rows
+ */
+void WaterfallWidget::rowsAdded(int rows){
+    Q_UNUSED(rows); // the row count is taken from the published frame
+    this->pendingFrames++;
+    if(!this->timer.isActive()){
+        this->timer.start();
+    }
+}
+
+/**
+ * @brief WaterfallWidget::viewChanged slot for changes that need a full repaint
+ */
+void WaterfallWidget::viewChanged(){
+    this->pendingFrames++;
+    if(!this->timer.isActive()){
+        this->timer.start();
+    }
+}
+
+/**
+ * @brief WaterfallWidget::flush turn everything that happened since the last tick into one repaint
+ */
+void WaterfallWidget::flush(){
+    if(this->pendingFrames == 0 || this->waterfall == nullptr){
+        this->timer.stop(); // idle, the next frame restarts the timer
+        return;
+    }
+
+    const WaterfallFrame* frame = this->waterfall->acquireFront();
+    quint64 rows = frame->rows;
+    quint64 generation = frame->generation;
+    this->waterfall->releaseFront();
+
+    quint64 added = rows - this->shownRows;
+    bool scrolledOff = generation == this->shownGeneration && added > quint64(this->height());
+    if(this->framebuffer != nullptr && this->blitDirect()){
+        // already on screen, Qt's copy of the widget is repainted from the front frame if it is ever flushed
+        if(scrolledOff){
+            this->dropped += added - this->height();
+        }
+    }else if(!this->isVisible()){
+        this->fullRepaint = true; // whatever is on screen will be repainted when shown
+    }else if(this->fullRepaint || generation != this->shownGeneration || added >= quint64(this->height())){
+        if(scrolledOff){
+            this->dropped += added - this->height();
+        }
+        this->update();
+    }else if(added > 0){
+        // move what is on screen down and paint only the exposed rows at the top
+        this->scroll(0, int(added));
+        this->shownRows = rows;
+        if(!this->markers.isEmpty()){
+            // marker lines scroll onto themselves, the labels moved and need redrawing
+            this->update(0, 0, this->width(), int(added) + this->labelHeight());
+        }
+    }
+
+    this->painted++;
+    this->coalesced += this->pendingFrames - 1;
+    this->pendingFrames = 0;
+
+    if(this->statsClock.elapsed() >= WATERFALL_STATS_INTERVAL){
+        this->statsClock.restart();
+        emit frameStats(this->painted, this->coalesced, this->dropped);
+    }
+}
+
+/**
+ * @brief WaterfallWidget::paintEvent blit the exposed region from the front frame
+ * @param event
+ */
+void WaterfallWidget::paintEvent(QPaintEvent* event){
+    QPainter painter(this);
+    if(this->waterfall == nullptr){
+        painter.fillRect(event->rect(), Qt::black);
+        return;
+    }
+
+    const WaterfallFrame* frame = this->waterfall->acquireFront();
+    for(const QRect& rect : event->region()){
+        painter.drawImage(rect.topLeft(), frame->image, rect);
+    }
+    this->paintMarkers(painter, event->region().boundingRect());
+    bool whole = event->region().contains(this->rect());
+    bool current = frame->rows == this->shownRows && frame->generation == this->shownGeneration;
+    quint64 rows = frame->rows;
+    quint64 generation = frame->generation;
+    this->waterfall->releaseFront();
+
+    if(whole){
+        this->shownRows = rows;
+        this->shownGeneration = generation;
+        this->fullRepaint = false;
+    }else if(!current){
+        // a newer frame was published between scrolling and painting, the exposed
+        // rows do not line up with the scrolled ones, repaint everything
+        this->fullRepaint = true;
+        this->update();
+    }
+}
+
+/**
+ * @brief WaterfallWidget::setFramebuffer draw new frames straight into a framebuffer
+ * @param framebuffer the screen Qt draws to, must outlive the widget, nullptr to only paint through Qt
+ */
+void WaterfallWidget::setFramebuffer(Framebuffer* framebuffer){
+    this->framebuffer = framebuffer != nullptr && framebuffer->isOpen() ? framebuffer : nullptr;
+}
+
+/**
+ * @brief WaterfallWidget::blitDirect draw the front frame and markers straight into the framebuffer
+ * @return false if Qt has to paint instead, because a popup, dialog or other window may be on top
+ * Runs in the GUI thread between Qt's own flushes, so the two never write at the same time.
+ * Only the part of the widget not covered by other widgets is drawn. Qt's backing store
+ * goes stale, but anything that makes Qt flush this area repaints the widget from the front frame.
+ */
+bool WaterfallWidget::blitDirect(){
+    if(!this->isVisible() || !this->window()->isActiveWindow() ||
+       QApplication::activePopupWidget() != nullptr || QApplication::activeModalWidget() != nullptr){
+        return false;
+    }
+    QRegion visible = this->visibleRegion();
+    if(visible.isEmpty()){
+        return true;
+    }
+
+    // on linuxfb the screen starts at the top left of the framebuffer
+    QPoint origin = this->mapToGlobal(QPoint(0, 0));
+    origin -= QGuiApplication::primaryScreen()->geometry().topLeft();
+
+    QPainter painter(&this->framebuffer->getImage());
+    painter.translate(origin);
+    painter.setClipRegion(visible);
+    const WaterfallFrame* frame = this->waterfall->acquireFront();
+    painter.drawImage(0, 0, frame->image);
+    this->shownRows = frame->rows;
+    this->shownGeneration = frame->generation;
+    this->waterfall->releaseFront();
+    this->paintMarkers(painter, this->rect());
+    painter.end();
+
+    this->fullRepaint = false;
+    this->direct++;
+    return true;
+}
+
+/**
+ * @brief WaterfallWidget::resizeEvent marker columns depend on the width
+ * @param event
+ */
+void WaterfallWidget::resizeEvent(QResizeEvent* event){
+    QWidget::resizeEvent(event);
+    this->markersValid = false;
+}
+
+/**
+ * @brief WaterfallWidget::setChannels known channels to mark, the index must outlive the widget
+ * @param channels nullptr for no markers
+ */
+void WaterfallWidget::setChannels(const ChannelIndex* channels){
+    this->channels = channels;
+    this->channelsChanged();
+}
+
+/**
+ * @brief WaterfallWidget::channelsChanged slot to call after the channel index was rebuilt
+ */
+void WaterfallWidget::channelsChanged(){
+    this->markersValid = false;
+    this->update();
+}
+
+/**
+ * @brief WaterfallWidget::setFrequencyWindow the frequencies the widget spans, for the channel markers
+ * @param center Hz at the middle of the widget
+ * @param span Hz across the widget
+ */
+void WaterfallWidget::setFrequencyWindow(double center, double span){
+    if(center == this->windowCenter && span == this->windowSpan){
+        return;
+    }
+    this->windowCenter = center;
+    this->windowSpan = span;
+    this->markersValid = false;
+    this->update();
+}
+
+/**
+ * @brief WaterfallWidget::labelHeight
+ * @return height in pixels of the strip at the top holding the marker labels
+ */
+int WaterfallWidget::labelHeight(){
+    return this->fontMetrics().height() + 2;
+}
+
+/**
+ * @brief WaterfallWidget::layoutMarkers work out the column and label of every visible channel
+ * a range query on the index, then one pass over the visible channels. Channels
+ * landing on an already used column are skipped, labels that would overlap are hidden.
+ */
+void WaterfallWidget::layoutMarkers(){
+    this->markers.clear();
+    this->markersValid = true;
+    if(this->channels == nullptr || this->windowSpan <= 0.0 || this->width() <= 0){
+        return;
+    }
+    this->markerVersion = this->channels->getVersion();
+
+    double low = this->windowCenter - this->windowSpan/2;
+    double pixelsPerHz = this->width()/this->windowSpan;
+    int first = 0;
+    int last = 0;
+    this->channels->range(low, this->windowCenter + this->windowSpan/2, &first, &last);
+
+    QFontMetrics metrics = this->fontMetrics();
+    int labelEnd = -1;  // first column free of the previous label
+    for(int i = first; i < last; i++){
+        const ChannelMarker& marker = this->channels->at(i);
+        int x = int((marker.frequency - low)*pixelsPerHz);
+        if(x >= this->width()){
+            x = this->width() - 1;
+        }
+        if(!this->markers.isEmpty() && this->markers.last().x == x){
+            continue;   // scanned channels sort first, they win the column
+        }
+        MarkerPosition position;
+        position.x = x;
+        position.index = i;
+        position.labelled = !marker.label.isEmpty() && x + 2 >= labelEnd;
+        if(position.labelled){
+            labelEnd = x + 2 + metrics.boundingRect(marker.label).width() + 4;
+        }
+        this->markers.append(position);
+    }
+}
+
+/**
+ * @brief WaterfallWidget::paintMarkers draw the channel markers over the blitted frame
+ * @param painter painting on the widget, clipped to the exposed region
+ * @param bounds bounding rectangle of the exposed region
+ */
+void WaterfallWidget::paintMarkers(QPainter& painter, const QRect& bounds){
+    if(this->channels == nullptr){
+        return;
+    }
+    if(!this->markersValid || this->markerVersion != this->channels->getVersion()){
+        this->layoutMarkers();
+    }
+    if(this->markers.isEmpty()){
+        return;
+    }
+
+    // markers are sorted by column, only the exposed columns are drawn
+    int from = 0;
+    while(from < this->markers.size() && this->markers[from].x < bounds.left()){
+        from++;
+    }
+    bool labels = bounds.top() < this->labelHeight();
+    int baseline = this->fontMetrics().ascent() + 1;
+    for(int i = from; i < this->markers.size() && this->markers[i].x <= bounds.right(); i++){
+        const MarkerPosition& position = this->markers[i];
+        const ChannelMarker& marker = this->channels->at(position.index);
+        painter.setPen(marker.scanned ? WATERFALL_SCAN_MARKER_COLOR : WATERFALL_MARKER_COLOR);
+        painter.drawLine(position.x, bounds.top(), position.x, bounds.bottom());
+    }
+    if(labels){
+        // labels reach right of their column, so earlier columns can overlap the region too
+        for(int i = 0; i < this->markers.size() && this->markers[i].x <= bounds.right(); i++){
+            const MarkerPosition& position = this->markers[i];
+            if(!position.labelled){
+                continue;
+            }
+            const ChannelMarker& marker = this->channels->at(position.index);
+            painter.setPen(marker.scanned ? WATERFALL_SCAN_MARKER_COLOR : WATERFALL_MARKER_COLOR);
+            painter.drawText(position.x + 2, baseline, marker.label);
+        }
+    }
+}
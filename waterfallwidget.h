@@ -0,0 +1,97 @@
+#ifndef WATERFALLWIDGET_H
+#define WATERFALLWIDGET_H
+
+#include <QWidget>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QFontMetrics>
+#include <QApplication>
+#include <QScreen>
+#include <QGuiApplication>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "waterfall.h"
+#include "channelindex.h"
+#include "framebuffer.h"
+
+#define WATERFALL_DEFAULT_FPS       30      // repaint rate cap, rows arriving faster are coalesced
+#define WATERFALL_STATS_INTERVAL    10000   // ms between frameStats reports
+#define WATERFALL_MARKER_COLOR      QColor(255, 255, 255, 110)  // known channels
+#define WATERFALL_SCAN_MARKER_COLOR QColor(255, 220, 0, 170)    // channels in the active scan list
+
+/**
+ * @brief The MarkerPosition struct is a channel marker laid out for the current frequency window
+ */
+struct MarkerPosition {
+    int x;              // pixel column
+    int index;          // position in the ChannelIndex
+    bool labelled;      // false if the label would overlap the previous one
+};
+
+/**
+ * @brief The WaterfallWidget class paints the Waterfall's published front frame
+ * New rows only scroll what is already on screen and paint the rows exposed at
+ * the top. Repaints are coalesced to at most the configured frame rate.
+ * The Waterfall may live in another thread, the widget only blits.
+ * Known channels inside the frequency window are drawn on top, their pixel
+ * positions are cached until the window or the channel list changes.
+ * With a framebuffer set, new frames are drawn straight into it instead of
+ * going through Qt's backing store, whenever nothing else is on top.
+ */
+class WaterfallWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit WaterfallWidget(QWidget *parent = nullptr);
+    void setWaterfall(Waterfall* waterfall);
+    void setChannels(const ChannelIndex* channels);
+    void setFramebuffer(Framebuffer* framebuffer);
+    quint64 getDirectFrames() { return direct; }
+    quint64 getPaintedFrames() { return painted; }
+    quint64 getCoalescedFrames() { return coalesced; }
+    quint64 getDroppedRows() { return dropped; }
+
+public slots:
+    void setMaxFps(int fps);
+    void rowsAdded(int rows);
+    void viewChanged();
+    void setFrequencyWindow(double center, double span);
+    void channelsChanged();
+
+signals:
+    void frameStats(quint64 painted, quint64 coalesced, quint64 dropped);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private slots:
+    void flush();
+
+private:
+    bool blitDirect();
+    void layoutMarkers();
+    void paintMarkers(QPainter& painter, const QRect& bounds);
+    int labelHeight();
+    Waterfall* waterfall = nullptr;
+    QTimer timer;
+    int pendingFrames = 0;      // rowsAdded/viewChanged calls since the last repaint
+    bool fullRepaint = true;    // the whole view changed, scrolling is not enough
+    quint64 shownRows = 0;      // WaterfallFrame::rows of what is on screen
+    quint64 shownGeneration = 0;
+    quint64 painted = 0;        // repaints scheduled
+    quint64 coalesced = 0;      // frames merged into a later repaint
+    quint64 dropped = 0;        // rows that scrolled off before they were ever painted
+    QElapsedTimer statsClock;
+    const ChannelIndex* channels = nullptr;
+    double windowCenter = 0.0;      // Hz at the middle of the widget
+    double windowSpan = 0.0;        // Hz across the widget
+    quint64 markerVersion = 0;      // ChannelIndex version the cache was laid out from
+    bool markersValid = false;
+    QVector<MarkerPosition> markers;    // visible channels left to right
+    Framebuffer* framebuffer = nullptr; // draw here directly, nullptr to always go through Qt
+    quint64 direct = 0;                 // frames drawn straight into the framebuffer
+};
+
+#endif // WATERFALLWIDGET_H